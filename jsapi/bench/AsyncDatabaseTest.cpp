@@ -0,0 +1,88 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+// AsyncDatabase on a file it can open and on one it cannot: jobs on the
+// first run and answer, and on the second every job fails instead of
+// waiting for a worker that has nothing to run them with.
+
+#include "BenchSupport.hpp"
+#include "Database/AsyncDatabase.hpp"
+#include <fstream>
+#include <iostream>
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what)
+{
+    if (condition)
+        return;
+    failures++;
+    std::cerr << "FAILED: " << what << std::endl;
+}
+
+template <typename T>
+static bool fails(std::future<T> future)
+{
+    try
+    {
+        future.get();
+        return false;
+    }
+    catch (const std::exception &)
+    {
+        return true;
+    }
+}
+
+static void opened()
+{
+    AsyncDatabase database(DATABASE_DIR "async.db");
+    database.write([](DATABASE &database)
+                   { database.query("CREATE TABLE numbers (value INTEGER)").execute(); });
+    for (int i = 0; i < 10; i++)
+        database.write([i](DATABASE &database)
+                       { database.insert("numbers").value("value", i).execute(); });
+    auto count = database.read([](DATABASE &database)
+                               { return database.size("numbers").execute(); });
+    check(count.get() == 10, "ten rows after ten queued inserts");
+    check(!fails(database.flush()), "flush of an open database");
+}
+
+static void unopenable()
+{
+    // A path under a regular file cannot be created, whoever runs the test
+    std::ofstream(DATABASE_DIR "file") << "not a directory";
+    AsyncDatabase database(DATABASE_DIR "file/async.db");
+    auto first = database.write([](DATABASE &database)
+                                { database.query("CREATE TABLE numbers (value INTEGER)").execute(); });
+    check(fails(std::move(first)), "write queued while the open fails");
+    check(fails(database.read([](DATABASE &database)
+                              { return database.size("numbers").execute(); })),
+          "read after the open failed");
+    check(fails(database.flush()), "flush after the open failed");
+}
+
+int main()
+{
+    resetDatabaseDir();
+    opened();
+    unopenable();
+    if (failures)
+        return 1;
+    std::cout << "all passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,61 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <Database/Includes.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Starts from empty databases under DATABASE_DIR, which the bench build
+// points at its own directory
+inline void resetDatabaseDir()
+{
+    std::filesystem::remove_all(DATABASE_DIR);
+    std::filesystem::create_directories(DATABASE_DIR);
+}
+
+// Samples of one measurement, reported as percentiles
+class Distribution
+{
+private:
+    std::vector<double> values;
+
+public:
+    void add(double value) { values.push_back(value); }
+    bool empty() const { return values.empty(); }
+    double percentile(double rank) const
+    {
+        if (values.empty())
+            return 0;
+        std::vector<double> sorted = values;
+        std::sort(sorted.begin(), sorted.end());
+        size_t index = (size_t)(rank / 100 * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+    // "p50/p90/p99/max" to two decimals
+    std::string summary() const
+    {
+        char text[96];
+        snprintf(text, sizeof(text), "%.2f/%.2f/%.2f/%.2f",
+                 percentile(50), percentile(90), percentile(99), percentile(100));
+        return text;
+    }
+};
@@ -0,0 +1,136 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+// Drives AI end to end against the stand-in server on a fresh database and
+// reports how replies are experienced: time to first delta, time to the
+// whole reply, time spent persisting and the bytes SQLite wrote to disk per
+// token, background checkpoints and snapshots during the scenario included.
+//
+//     generation_bench [replies per scenario]
+
+#include "BenchSupport.hpp"
+#include "StandInServer.hpp"
+#include "AI/AI.hpp"
+#include "AI/GenerationStats.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+struct Scenario
+{
+    const char *name;
+    StandInScript script;
+};
+
+static std::string repeat(const std::string &text, size_t bytes)
+{
+    std::string result;
+    while (result.size() < bytes)
+        result += text;
+    return result;
+}
+
+static std::vector<Scenario> scenarios()
+{
+    const std::string english = "The quick brown fox jumps over the lazy dog. ";
+    const std::string chinese = "今天天气很好，我们一起去公园散步吧。";
+    std::vector<Scenario> list;
+
+    StandInScript burst;
+    burst.reply = repeat(english, 4096);
+    list.push_back({"burst", burst});
+
+    StandInScript paced;
+    paced.reply = repeat(english, 2048);
+    paced.tokenInterval = std::chrono::milliseconds(2);
+    list.push_back({"paced", paced});
+
+    StandInScript cjk;
+    cjk.reply = repeat(chinese, 3072);
+    cjk.tokenBytes = 3;
+    cjk.tokenInterval = std::chrono::milliseconds(1);
+    list.push_back({"cjk", cjk});
+
+    StandInScript fragmented;
+    fragmented.reply = repeat(english, 2048);
+    fragmented.writeBytes = 7;
+    list.push_back({"fragmented", fragmented});
+
+    StandInScript slowStart;
+    slowStart.reply = repeat(english, 1024);
+    slowStart.headerDelay = std::chrono::milliseconds(100);
+    list.push_back({"slow-start", slowStart});
+
+    StandInScript large;
+    large.reply = repeat(english, 64 * 1024);
+    large.tokenBytes = 16;
+    list.push_back({"large", large});
+    return list;
+}
+
+int main(int argc, char **argv)
+{
+    size_t replies = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20;
+    resetDatabaseDir();
+    AI ai;
+
+    printf("%-11s %7s  %-31s %-31s %-31s %10s %9s\n", "scenario", "replies",
+           "first delta ms p50/90/99/max", "reply ms p50/90/99/max", "persist ms p50/90/99/max", "disk B/tok", "deltas");
+    bool mismatch = false;
+    for (const Scenario &scenario : scenarios())
+    {
+        StandInServer server(scenario.script);
+        ai.setSettings("stand-in", server.url(), "stand-in", 4096, 0.7, 1.0, "You are a benchmark.", 65536);
+        ai.createConversation(scenario.name);
+        GenerationStats::instance().reset();
+        uint64_t writtenBefore = WriteCounter::bytesWritten();
+
+        Distribution firstDelta, total, persist;
+        size_t deltas = 0;
+        for (size_t reply = 0; reply < replies; reply++)
+        {
+            ai.addNode(ConversationNode::ROLE_USER, "Question " + std::to_string(reply));
+            auto start = std::chrono::steady_clock::now();
+            std::chrono::steady_clock::time_point first;
+            std::string text = ai.generateResponse([&](const std::string &, const std::string &, const std::string &)
+                                                   {
+                                                       if (first == std::chrono::steady_clock::time_point{})
+                                                           first = std::chrono::steady_clock::now();
+                                                       deltas++; });
+            auto end = std::chrono::steady_clock::now();
+            mismatch |= text != scenario.script.reply;
+            firstDelta.add(std::chrono::duration<double, std::milli>(first - start).count());
+            total.add(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+
+        uint64_t bytesWritten = WriteCounter::bytesWritten() - writtenBefore, tokens = 0;
+        for (const GenerationSample &sample : GenerationStats::instance().getSamples())
+        {
+            persist.add(sample.persistUs / 1000.0);
+            tokens += sample.tokens;
+        }
+        printf("%-11s %7zu  %-31s %-31s %-31s %10.2f %9.1f\n", scenario.name, replies,
+               firstDelta.summary().c_str(), total.summary().c_str(), persist.summary().c_str(),
+               tokens ? (double)bytesWritten / tokens : 0.0, replies ? (double)deltas / replies : 0.0);
+    }
+    if (mismatch)
+    {
+        std::cerr << "A reply differed from what the server sent" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+// Hedged replies against the stand-in server with stalls injected before
+// the response headers: the hedge has to win when the first attempt stalls,
+// must not be sent when it does not, and a stop has to end both attempts.
+
+#include "BenchSupport.hpp"
+#include "StandInServer.hpp"
+#include "AI/AI.hpp"
+#include "AI/GenerationStats.hpp"
+#include <iostream>
+#include <thread>
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what)
+{
+    if (condition)
+        return;
+    failures++;
+    std::cerr << "FAILED: " << what << std::endl;
+}
+
+// Recent first tokens of 100 ms put the hedge delay at its 500 ms floor
+static void primeFirstTokens()
+{
+    GenerationStats::instance().reset();
+    for (int i = 0; i < 10; i++)
+    {
+        GenerationSample sample;
+        sample.timestamp = 0;
+        sample.firstTokenUs = 100000;
+        sample.stopReason = ConversationNode::STOP_REASON_STOP;
+        GenerationStats::instance().record(sample);
+    }
+}
+
+struct Outcome
+{
+    std::string text;
+    double ms;
+    GenerationSample sample;
+    ConversationNodeView node;
+    size_t siblings;
+};
+
+static Outcome generate(AI &ai, const std::string &question)
+{
+    primeFirstTokens();
+    ai.addNode(ConversationNode::ROLE_USER, question);
+    std::string parentId = ai.getCurrentNodeId();
+    auto start = std::chrono::steady_clock::now();
+    std::string text = ai.generateResponse([](const std::string &, const std::string &, const std::string &) {});
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return {text, ms, GenerationStats::instance().getSamples().back(), ai.getCurrentPath().back(),
+            ai.getChildren(parentId).size()};
+}
+
+int main()
+{
+    resetDatabaseDir();
+    AI ai;
+    ai.createConversation("hedging");
+    std::string reply;
+    while (reply.size() < 2048)
+        reply += "Whichever attempt answers first is kept. ";
+    const std::chrono::milliseconds stall(3000);
+
+    {
+        // Every reply's first attempt lands on an even connection and stalls
+        StandInScript script;
+        script.reply = reply;
+        script.headerDelay = stall;
+        script.delayConnection = [](size_t connection)
+        { return connection % 2 == 0; };
+        StandInServer server(script);
+        ai.setSettings("stand-in", server.url(), "stand-in", 4096, 0.7, 1.0, "You are a test.", 65536);
+
+        ai.setHedging(true, 95);
+        primeFirstTokens();
+        check(ai.getHedging().delayMs == 500, "hedge delay at its floor, got " + std::to_string(ai.getHedging().delayMs));
+        for (int i = 0; i < 3; i++)
+        {
+            Outcome outcome = generate(ai, "Stalled " + std::to_string(i));
+            check(outcome.text == reply, "hedged reply arrives whole");
+            check(outcome.ms < stall.count() / 2, "hedge answers before the stall ends, took " + std::to_string(outcome.ms) + " ms");
+            check(outcome.sample.attempts == 2 && outcome.sample.winningAttempt == 1, "the hedge is sent and wins");
+            check(outcome.sample.hedgeDelayUs == 500000, "hedge waits for its delay");
+            check(*outcome.node.content == reply && outcome.node.stopReason == ConversationNode::STOP_REASON_STOP,
+                  "the hedge's reply is stored");
+            check(outcome.siblings == 1, "the losing attempt leaves no node behind");
+        }
+        check(server.connectionCount() == 6, "two connections per hedged reply");
+
+        ai.setHedging(false, 95);
+        Outcome outcome = generate(ai, "Unhedged");
+        check(outcome.text == reply && outcome.ms >= stall.count(), "without hedging the stall is waited out");
+        check(outcome.sample.attempts == 1, "without hedging one attempt is sent");
+    }
+
+    {
+        StandInScript script;
+        script.reply = reply;
+        StandInServer server(script);
+        ai.setSettings("stand-in", server.url(), "stand-in", 4096, 0.7, 1.0, "You are a test.", 65536);
+        ai.setHedging(true, 95);
+        for (int i = 0; i < 3; i++)
+        {
+            Outcome outcome = generate(ai, "Prompt " + std::to_string(i));
+            check(outcome.text == reply, "prompt reply arrives whole");
+            check(outcome.sample.attempts == 1, "a prompt reply sends no hedge");
+        }
+        check(server.connectionCount() == 3, "one connection per prompt reply");
+    }
+
+    {
+        // With both attempts stalled, a stop still ends the reply at once
+        StandInScript script;
+        script.reply = reply;
+        script.headerDelay = std::chrono::milliseconds(10000);
+        StandInServer server(script);
+        ai.setSettings("stand-in", server.url(), "stand-in", 4096, 0.7, 1.0, "You are a test.", 65536);
+        std::chrono::steady_clock::time_point stoppedAt;
+        std::thread stopper([&]()
+                            {
+                                std::this_thread::sleep_for(std::chrono::milliseconds(800));
+                                stoppedAt = std::chrono::steady_clock::now();
+                                ai.stopGeneration(); });
+        Outcome outcome = generate(ai, "Both stall");
+        stopper.join();
+        double afterStop = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stoppedAt).count();
+        check(outcome.text.empty() && afterStop < 500, "a stop ends both stalled attempts, took " + std::to_string(afterStop) + " ms");
+        check(outcome.sample.attempts == 2, "the hedge was sent before the stop");
+        check(server.connectionCount() == 2, "both attempts connected");
+    }
+
+    if (failures)
+        std::cerr << failures << " checks failed" << std::endl;
+    else
+        std::cout << "all checks passed" << std::endl;
+    return failures ? 1 : 0;
+}
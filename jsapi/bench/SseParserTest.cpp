@@ -0,0 +1,142 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+// SseParser fed streams split at every possible point, directly and over a
+// socket from the stand-in server writing one byte at a time.
+
+#include "StandInServer.hpp"
+#include "Fetch.hpp"
+#include "SseParser.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct Event
+{
+    std::string event, data, id;
+    bool operator==(const Event &other) const
+    {
+        return event == other.event && data == other.data && id == other.id;
+    }
+};
+
+struct Case
+{
+    const char *name;
+    std::string stream;
+    std::vector<Event> expected;
+};
+
+static std::vector<Case> cases()
+{
+    return {
+        {"lf", "data: a\n\ndata: b\n\n", {{"message", "a", ""}, {"message", "b", ""}}},
+        {"crlf", "data: a\r\n\r\ndata: b\r\n\r\n", {{"message", "a", ""}, {"message", "b", ""}}},
+        {"cr", "data: a\r\rdata: b\r\r", {{"message", "a", ""}, {"message", "b", ""}}},
+        {"multi-line data", "data: a\ndata:\ndata: b\n\n", {{"message", "a\n\nb", ""}}},
+        {"event and id", "event: x\nid: 7\ndata: d\n\ndata: e\n\n", {{"x", "d", "7"}, {"message", "e", "7"}}},
+        {"comments and unknown fields", ": ping\nretry: 5\nfoo\n\ndata: z\n\n", {{"message", "z", ""}}},
+        {"bom", "\xEF\xBB\xBF"
+                "data: bom\n\n",
+         {{"message", "bom", ""}}},
+        {"no space", "data:x\ndata:  y\n\n", {{"message", "x\n y", ""}}},
+        {"empty data", "data\n\ndata:\n\n", {{"message", "", ""}, {"message", "", ""}}},
+        {"utf-8", "data: 你好\n\n", {{"message", "你好", ""}}},
+        {"unterminated", "data: a\n\ndata: last", {{"message", "a", ""}, {"message", "last", ""}}},
+        {"no trailing blank line", "data: a\n", {{"message", "a", ""}}},
+    };
+}
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what)
+{
+    if (condition)
+        return;
+    failures++;
+    std::cerr << "FAILED: " << what << std::endl;
+}
+
+static std::vector<Event> parse(const std::string &stream, const std::vector<size_t> &splits)
+{
+    std::vector<Event> events;
+    SseParser parser([&events](const SseEvent &event)
+                     { events.push_back({std::string(event.event), std::string(event.data), std::string(event.id)}); });
+    size_t offset = 0;
+    for (size_t split : splits)
+    {
+        parser.feed(stream.data() + offset, split - offset);
+        offset = split;
+    }
+    parser.feed(stream.data() + offset, stream.size() - offset);
+    parser.finish();
+    return events;
+}
+
+static std::vector<Event> fetch(const StandInScript &script)
+{
+    StandInServer server(script);
+    std::vector<Event> events;
+    Response response = Fetch::fetch(server.url() + "chat/completions",
+                                     FetchOptions("POST", {{"Content-Type", "application/json"}}, "{}", true,
+                                                  [&events](const SseEvent &event)
+                                                  { events.push_back({std::string(event.event), std::string(event.data), std::string(event.id)}); },
+                                                  30));
+    check(response.status == 200, "stand-in server answered with " + std::to_string(response.status));
+    return events;
+}
+
+int main()
+{
+    for (const Case &test : cases())
+    {
+        std::string name = test.name;
+        check(parse(test.stream, {}) == test.expected, name + ": whole");
+
+        std::vector<size_t> everyByte;
+        for (size_t i = 1; i < test.stream.size(); i++)
+            everyByte.push_back(i);
+        check(parse(test.stream, everyByte) == test.expected, name + ": byte by byte");
+
+        for (size_t i = 1; i < test.stream.size(); i++)
+            for (size_t j = i; j < test.stream.size(); j++)
+                check(parse(test.stream, {i, j}) == test.expected,
+                      name + ": split at " + std::to_string(i) + " and " + std::to_string(j));
+
+        StandInScript script;
+        script.body = test.stream;
+        script.writeBytes = 1;
+        script.writeInterval = std::chrono::microseconds(50);
+        check(fetch(script) == test.expected, name + ": over a socket, byte by byte");
+    }
+
+    // A scripted reply, fragmented the same way, arrives event for event
+    StandInScript script;
+    script.reply = "Fragments of 你好 at every byte.";
+    script.writeBytes = 1;
+    script.writeInterval = std::chrono::microseconds(50);
+    std::vector<Event> expected;
+    for (const std::string &event : StandInServer::events(script))
+        expected.push_back({"message", event.substr(6, event.size() - 8), ""});
+    check(fetch(script) == expected, "scripted reply over a socket, byte by byte");
+
+    if (failures)
+        std::cerr << failures << " checks failed" << std::endl;
+    else
+        std::cout << "all checks passed" << std::endl;
+    return failures ? 1 : 0;
+}
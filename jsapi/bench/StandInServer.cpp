@@ -0,0 +1,222 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "StandInServer.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static constexpr std::chrono::milliseconds POLL_SLICE{50};
+
+StandInServer::StandInServer(StandInScript script) : script(std::move(script))
+{
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0)
+        throw std::runtime_error("socket failed");
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(listenFd, 16) != 0 ||
+        getsockname(listenFd, reinterpret_cast<sockaddr *>(&address), &length) != 0)
+    {
+        close(listenFd);
+        throw std::runtime_error("cannot listen on 127.0.0.1");
+    }
+    port = ntohs(address.sin_port);
+    acceptor = std::thread(&StandInServer::acceptLoop, this);
+}
+StandInServer::~StandInServer()
+{
+    stopping = true;
+    acceptor.join();
+    for (auto &handler : handlers)
+        handler.join();
+    close(listenFd);
+}
+
+std::string StandInServer::url() const
+{
+    return "http://127.0.0.1:" + std::to_string(port) + "/";
+}
+
+std::vector<std::string> StandInServer::events(const StandInScript &script)
+{
+    auto chunk = [](nlohmann::json delta, nlohmann::json finishReason)
+    {
+        nlohmann::json event = {{"id", "chatcmpl-standin"},
+                                {"object", "chat.completion.chunk"},
+                                {"created", 0},
+                                {"model", "stand-in"},
+                                {"choices", {{{"index", 0}, {"delta", std::move(delta)}, {"finish_reason", std::move(finishReason)}}}}};
+        return "data: " + event.dump() + "\n\n";
+    };
+    std::vector<std::string> events;
+    events.push_back(chunk({{"role", "assistant"}, {"content", ""}}, nullptr));
+    size_t tokenBytes = std::max<size_t>(script.tokenBytes, 1);
+    for (size_t offset = 0; offset < script.reply.size();)
+    {
+        size_t end = std::min(script.reply.size(), offset + tokenBytes);
+        while (end < script.reply.size() && (static_cast<unsigned char>(script.reply[end]) & 0xC0) == 0x80)
+            end++;
+        events.push_back(chunk({{"content", script.reply.substr(offset, end - offset)}}, nullptr));
+        offset = end;
+    }
+    events.push_back(chunk(nlohmann::json::object(), "stop"));
+    events.push_back("data: [DONE]\n\n");
+    return events;
+}
+
+void StandInServer::acceptLoop()
+{
+    while (!stopping)
+    {
+        pollfd listener{listenFd, POLLIN, 0};
+        if (poll(&listener, 1, (int)POLL_SLICE.count()) <= 0)
+            continue;
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+        // Every write leaves as its own segment, so fragments reach the client as scripted
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        size_t connection = connections++;
+        std::lock_guard<std::mutex> lock(handlersMutex);
+        handlers.emplace_back(&StandInServer::serve, this, fd, connection);
+    }
+}
+
+bool StandInServer::idle(int fd, std::chrono::microseconds duration)
+{
+    auto deadline = std::chrono::steady_clock::now() + duration;
+    while (!stopping)
+    {
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= std::chrono::steady_clock::duration::zero())
+            return true;
+        auto slice = std::min<std::chrono::steady_clock::duration>(remaining, POLL_SLICE);
+        timespec timeout{(time_t)std::chrono::duration_cast<std::chrono::seconds>(slice).count(),
+                         (long)(std::chrono::duration_cast<std::chrono::nanoseconds>(slice).count() % 1000000000)};
+        pollfd client{fd, POLLIN, 0};
+        if (ppoll(&client, 1, &timeout, nullptr) <= 0)
+            continue;
+        // The request has been read in full, so anything readable is the hang-up
+        char byte;
+        if (recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) <= 0)
+            return false;
+        recv(fd, &byte, 1, MSG_DONTWAIT);
+    }
+    return false;
+}
+
+bool StandInServer::send(int fd, const std::string &data)
+{
+    for (size_t sent = 0; sent < data.size();)
+    {
+        ssize_t written = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (written <= 0)
+            return false;
+        sent += written;
+    }
+    return true;
+}
+
+void StandInServer::serve(int fd, size_t connection)
+{
+    // The request is read in full first; only its length matters
+    std::string request;
+    char buffer[4096];
+    size_t headerEnd;
+    while ((headerEnd = request.find("\r\n\r\n")) == std::string::npos)
+    {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+        {
+            close(fd);
+            return;
+        }
+        request.append(buffer, received);
+    }
+    std::string headers = request.substr(0, headerEnd);
+    std::transform(headers.begin(), headers.end(), headers.begin(), [](unsigned char c)
+                   { return std::tolower(c); });
+    size_t contentLength = 0;
+    if (size_t field = headers.find("\r\ncontent-length:"); field != std::string::npos)
+        contentLength = std::stoul(headers.substr(field + 17));
+    if (headers.find("\r\nexpect: 100-continue") != std::string::npos)
+        send(fd, "HTTP/1.1 100 Continue\r\n\r\n");
+    while (request.size() - headerEnd - 4 < contentLength)
+    {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+        {
+            close(fd);
+            return;
+        }
+        request.append(buffer, received);
+    }
+
+    bool delayed = !script.delayConnection || script.delayConnection(connection);
+    if (delayed && script.headerDelay.count() > 0 && !idle(fd, script.headerDelay))
+    {
+        close(fd);
+        return;
+    }
+    // Without a length or chunking, the body runs until the connection closes
+    if (!send(fd, "HTTP/1.1 200 OK\r\n"
+                  "Content-Type: text/event-stream\r\n"
+                  "Cache-Control: no-cache\r\n"
+                  "Connection: close\r\n\r\n"))
+    {
+        close(fd);
+        return;
+    }
+
+    std::vector<std::string> pieces = script.body.empty() ? events(script) : std::vector<std::string>{script.body};
+    bool open = true;
+    for (size_t i = 0; i < pieces.size() && open; i++)
+    {
+        if (i == script.stallAfter)
+        {
+            while (idle(fd, POLL_SLICE))
+                ;
+            break;
+        }
+        if (i > 0 && script.tokenInterval.count() > 0)
+            open = idle(fd, script.tokenInterval);
+        const std::string &piece = pieces[i];
+        size_t writeBytes = script.writeBytes ? script.writeBytes : piece.size();
+        for (size_t offset = 0; offset < piece.size() && open; offset += writeBytes)
+        {
+            if (offset > 0 && script.writeInterval.count() > 0)
+                open = idle(fd, script.writeInterval);
+            open = open && send(fd, piece.substr(offset, writeBytes));
+        }
+    }
+    close(fd);
+}
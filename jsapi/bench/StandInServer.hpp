@@ -0,0 +1,88 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// What the stand-in server answers every POST with
+struct StandInScript
+{
+    // Streamed as chat.completion.chunk events of about tokenBytes each,
+    // UTF-8 sequences kept whole, then finish_reason "stop" and [DONE]
+    std::string reply;
+    size_t tokenBytes = 4;
+    std::chrono::microseconds tokenInterval{0};
+    // Sent as the body instead of the scripted events when not empty, such
+    // as a recorded capture
+    std::string body;
+    // Writes go out in pieces of at most this many bytes, this far apart;
+    // 0 writes each event whole
+    size_t writeBytes = 0;
+    std::chrono::microseconds writeInterval{0};
+    // Held back before the response headers, on the connections for which
+    // delayConnection returns true, or on all of them when it is unset
+    std::chrono::milliseconds headerDelay{0};
+    std::function<bool(size_t connection)> delayConnection;
+    // After this many events the stream goes silent until the client hangs up
+    size_t stallAfter = SIZE_MAX;
+};
+
+// A local OpenAI-compatible chat/completions endpoint on 127.0.0.1, for
+// driving Fetch and AI on a host without the real API. Each connection is
+// served on its own thread and closed after one response.
+class StandInServer
+{
+private:
+    StandInScript script;
+    int listenFd = -1;
+    uint16_t port = 0;
+    std::thread acceptor;
+    std::vector<std::thread> handlers;
+    std::mutex handlersMutex;
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> connections{0};
+
+    void acceptLoop();
+    void serve(int fd, size_t connection);
+    // Waits up to duration; false once the client has hung up or the server is stopping
+    bool idle(int fd, std::chrono::microseconds duration);
+    bool send(int fd, const std::string &data);
+
+public:
+    explicit StandInServer(StandInScript script);
+    StandInServer(const StandInServer &) = delete;
+    StandInServer &operator=(const StandInServer &) = delete;
+    ~StandInServer();
+
+    // The base URL AI expects, ending in a slash
+    std::string url() const;
+    size_t connectionCount() const { return connections.load(); }
+
+    // The scripted reply as chat.completion.chunk events, each a complete
+    // "data: ...\n\n" block
+    static std::vector<std::string> events(const StandInScript &script);
+};
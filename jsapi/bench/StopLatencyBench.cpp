@@ -0,0 +1,102 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+// How long stopGeneration takes to end a reply: with the stream stalled,
+// where nothing arrives to notice the stop on, and while it is streaming.
+// The reply must be stored as stopped with the text received so far.
+//
+//     stop_latency_bench [stops per scenario]
+
+#include "BenchSupport.hpp"
+#include "StandInServer.hpp"
+#include "AI/AI.hpp"
+#include "AI/GenerationStats.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+struct Scenario
+{
+    const char *name;
+    StandInScript script;
+};
+
+int main(int argc, char **argv)
+{
+    size_t stops = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20;
+    resetDatabaseDir();
+    AI ai;
+
+    std::string reply;
+    while (reply.size() < 8192)
+        reply += "Stop me whenever you like. ";
+    // The first event carries only the role; the stall leaves 20 deltas received
+    StandInScript stalled;
+    stalled.reply = reply;
+    stalled.stallAfter = 21;
+    StandInScript streaming;
+    streaming.reply = reply;
+    streaming.tokenInterval = std::chrono::milliseconds(5);
+    const Scenario scenarios[] = {{"stalled", stalled}, {"streaming", streaming}};
+
+    printf("%-10s %6s  %-31s %-31s\n", "scenario", "stops", "return ms p50/90/99/max", "saved ms p50/90/99/max");
+    int failures = 0;
+    for (const Scenario &scenario : scenarios)
+    {
+        StandInServer server(scenario.script);
+        ai.setSettings("stand-in", server.url(), "stand-in", 4096, 0.7, 1.0, "You are a benchmark.", 65536);
+        ai.createConversation(scenario.name);
+        GenerationStats::instance().reset();
+
+        Distribution returned, saved;
+        for (size_t stop = 0; stop < stops; stop++)
+        {
+            ai.addNode(ConversationNode::ROLE_USER, "Question " + std::to_string(stop));
+            std::atomic<size_t> deltas{0};
+            std::chrono::steady_clock::time_point stoppedAt;
+            // Stops land at varying points after the 20th delta
+            std::thread stopper([&]()
+                                {
+                                    while (deltas < 20)
+                                        std::this_thread::sleep_for(std::chrono::microseconds(200));
+                                    std::this_thread::sleep_for(std::chrono::milliseconds(10 + stop * 7 % 50));
+                                    stoppedAt = std::chrono::steady_clock::now();
+                                    ai.stopGeneration(); });
+            std::string received;
+            std::string text = ai.generateResponse([&](const std::string &, const std::string &, const std::string &delta)
+                                                   {
+                                                       received += delta;
+                                                       deltas++; });
+            auto end = std::chrono::steady_clock::now();
+            stopper.join();
+            returned.add(std::chrono::duration<double, std::milli>(end - stoppedAt).count());
+
+            ConversationNodeView node = ai.getCurrentPath().back();
+            if (node.stopReason != ConversationNode::STOP_REASON_USER_STOPPED || *node.content != received || text != received)
+            {
+                failures++;
+                std::cerr << scenario.name << ": reply " << stop << " was not stored as stopped with its text" << std::endl;
+            }
+        }
+        for (const GenerationSample &sample : GenerationStats::instance().getSamples())
+            saved.add(sample.cancelLatencyUs / 1000.0);
+        printf("%-10s %6zu  %-31s %-31s\n", scenario.name, stops, returned.summary().c_str(), saved.summary().c_str());
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+// StreamDelta against nlohmann on captured chat.completion.chunk streams:
+// checks that both extract the same fields from every event, then times
+// them.
+//
+//     stream_delta_bench [iterations]
+
+#include "SseParser.hpp"
+#include "AI/StreamDelta.hpp"
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+struct Fields
+{
+    std::string content, reasoningContent, finishReason;
+    bool hasFinishReason = false;
+    bool operator==(const Fields &other) const
+    {
+        return content == other.content && reasoningContent == other.reasoningContent &&
+               finishReason == other.finishReason && hasFinishReason == other.hasFinishReason;
+    }
+};
+
+// What a reply took from a chunk before StreamDelta, a full document
+static Fields reference(const std::string &json)
+{
+    Fields fields;
+    nlohmann::json chunkJson = nlohmann::json::parse(json);
+    auto choice = chunkJson["choices"][0];
+    if (choice["finish_reason"].is_string())
+    {
+        fields.finishReason = choice["finish_reason"];
+        fields.hasFinishReason = true;
+    }
+    if (choice["delta"]["reasoning_content"].is_string())
+        fields.reasoningContent = choice["delta"]["reasoning_content"];
+    if (choice["delta"]["content"].is_string())
+        fields.content = choice["delta"]["content"];
+    return fields;
+}
+static Fields extracted(StreamDelta &delta, const std::string &json)
+{
+    delta.parse(json);
+    return {delta.content, delta.reasoningContent, delta.finishReason, delta.hasFinishReason};
+}
+
+static std::vector<std::string> readEvents(const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string text = stream.str();
+    std::vector<std::string> events;
+    SseParser parser([&events](const SseEvent &event)
+                     {
+                         if (event.data != "[DONE]")
+                             events.emplace_back(event.data); });
+    parser.feed(text.data(), text.size());
+    parser.finish();
+    return events;
+}
+
+template <typename Parse>
+static double nanosecondsPerEvent(const std::vector<std::string> &events, size_t iterations, Parse parse)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+        for (const std::string &event : events)
+            parse(event);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (iterations * events.size());
+}
+
+int main(int argc, char **argv)
+{
+    size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200;
+    int failures = 0;
+    StreamDelta delta;
+
+    // Repeated keys keep the last value, as nlohmann does
+    const char *duplicates[] = {
+        R"({"choices":[{"delta":{"content":"a","content":null}}]})",
+        R"({"choices":[{"delta":{"content":null,"content":"b"}}]})",
+        R"({"choices":[{"delta":{"content":"a"},"delta":{"reasoning_content":"r"}}]})",
+        R"({"choices":[{"finish_reason":"stop","finish_reason":null}]})",
+        R"({"choices":[{"delta":{"content":"a"}}],"choices":[{"delta":{}}]})",
+        R"({"choices":[{"delta":{"reasoning_content":"r","reasoning_content":"s"}}]})",
+    };
+    for (const char *json : duplicates)
+        if (!(extracted(delta, json) == reference(json)))
+        {
+            failures++;
+            std::cerr << "Differs from nlohmann: " << json << std::endl;
+        }
+
+    printf("%-22s %7s %9s %14s %14s %8s\n", "capture", "events", "bytes", "StreamDelta ns", "nlohmann ns", "speedup");
+    for (const auto &entry : std::filesystem::directory_iterator(CAPTURE_DIR))
+    {
+        if (entry.path().extension() != ".sse")
+            continue;
+        std::vector<std::string> events = readEvents(entry.path());
+        size_t bytes = 0;
+        for (const std::string &event : events)
+        {
+            bytes += event.size();
+            if (!(extracted(delta, event) == reference(event)))
+            {
+                failures++;
+                std::cerr << entry.path().filename().string() << ": differs from nlohmann: " << event << std::endl;
+            }
+        }
+        if (events.empty())
+            continue;
+        double scanned = nanosecondsPerEvent(events, iterations, [&delta](const std::string &event)
+                                             { delta.parse(event); });
+        double full = nanosecondsPerEvent(events, iterations, [](const std::string &event)
+                                          { reference(event); });
+        printf("%-22s %7zu %9zu %14.0f %14.0f %7.1fx\n", entry.path().filename().string().c_str(),
+               events.size(), bytes, scanned, full, full / scanned);
+    }
+    return failures ? 1 : 0;
+}
@@ -16,8 +16,12 @@
 // along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "AI.hpp"
+#include "StreamDelta.hpp"
 #include "strUtils.hpp"
+#include <Exceptions/CurlError.hpp>
 #include <Exceptions/NetworkError.hpp>
+#include <algorithm>
+#include <iterator>
 #include <iostream>
 #include <sstream>
 #include <regex>
@@ -28,59 +32,177 @@ AI::AI()
     std::lock_guard<std::mutex> settingsLock(settingsMutex);
     std::lock_guard<std::mutex> conversationLock(conversationMutex);
 
-    conversationManager.loadApiSettings(apiKey, baseUrl, model, maxTokens, temperature, topP, systemPrompt);
+    conversationManager.loadApiSettings(apiKey, baseUrl, model, maxTokens, temperature, topP, systemPrompt, contextTokens);
+    conversationManager.loadHedgeSettings(hedgeEnabled, hedgePercentile);
+    credentials = strUtils::hash128(baseUrl + '\0' + apiKey);
+    endpointCache = conversationManager.loadApiCache();
 
-    auto conversationsResponse = conversationManager.getConversationList();
+    auto conversationsResponse = conversationManager.getConversationList(LLONG_MAX, "", 1);
     if (conversationsResponse.empty())
     {
         conversationManager.createConversation("默认对话", conversationId);
 
         std::unique_lock<std::shared_mutex> stateLock(stateMutex);
-        currentNodeId = rootNodeId = strUtils::randomId();
-        nodeMap[currentNodeId] = std::make_unique<ConversationNode>(
-            currentNodeId, ConversationNode::ROLE_SYSTEM, systemPrompt, "");
+        currentNode = rootNode = addToTree(ConversationNode(strUtils::randomId(), ConversationNode::ROLE_SYSTEM, systemPrompt),
+                                           ConversationTree::NONE);
         stateLock.unlock();
         saveConversation();
     }
     else
     {
-        conversationId = conversationsResponse[0].id;
         std::unique_lock<std::shared_mutex> stateLock(stateMutex);
-        conversationManager.loadConversation(conversationId, nodeMap, rootNodeId, currentNodeId);
+        loadTree(conversationsResponse[0].id);
     }
+
+    refreshWorker = std::thread(&AI::runRefreshes, this);
+}
+AI::~AI()
+{
+    {
+        std::lock_guard<std::mutex> cacheLock(endpointCacheMutex);
+        stopping = true;
+    }
+    refreshCondition.notify_one();
+    refreshWorker.join();
 }
 
-ConversationNode *AI::findNode(const std::string &nodeId)
+// Caller holds stateMutex exclusively
+void AI::resetTree()
+{
+    tree.clear();
+    currentNode = rootNode = ConversationTree::NONE;
+    deletedNodeIds.clear();
+    changedNodes.clear();
+    messageCount = 0;
+    contentLru.clear();
+    contentLruIndex.clear();
+}
+// Caller holds stateMutex exclusively. Makes conversationId the loaded
+// conversation, with its tree and message count read from storage.
+void AI::loadTree(const std::string &conversationId)
 {
-    auto it = nodeMap.find(nodeId);
-    return (it != nodeMap.end()) ? it->second.get() : nullptr;
+    this->conversationId = conversationId;
+    resetTree();
+    conversationManager.loadConversation(conversationId, tree, rootNode, currentNode);
+    tree.forEach([&](const ConversationNode &node)
+                 {
+                     if (node.role != ConversationNode::ROLE_SYSTEM)
+                         messageCount++; });
+}
+// Caller holds stateMutex exclusively
+ConversationTree::Handle AI::addToTree(ConversationNode node, ConversationTree::Handle parent)
+{
+    if (node.role != ConversationNode::ROLE_SYSTEM)
+        messageCount++;
+    ConversationTree::Handle handle = tree.add(std::move(node), parent);
+    changedNodes.push_back(handle);
+    // A conversation stored without nodes loads with no root; its first node becomes it
+    if (parent == ConversationTree::NONE && !tree.contains(rootNode))
+        rootNode = handle;
+    return handle;
+}
+// Caller holds stateMutex exclusively; call before setting the node's dirty flag
+void AI::markChanged(ConversationTree::Handle handle)
+{
+    const ConversationNode &node = tree[handle];
+    if (!node.isNew && !node.dirty)
+        changedNodes.push_back(handle);
 }
 
-std::vector<ConversationNode> AI::getPathFromRoot(const std::string &nodeId)
+// Fetches whatever content of nodes is missing in one batch and marks the
+// nodes recently used; the least recently used stored bodies past
+// CONTENT_CACHE_SIZE are released. Bodies the caller fetched already are
+// passed in fetched, by node id. Caller holds stateMutex exclusively.
+void AI::loadContent(const std::vector<ConversationTree::Handle> &handles,
+                     std::unordered_map<std::string, std::string> fetched)
 {
-    std::vector<ConversationNode> path;
-    std::string currentId = nodeId;
-    while (!currentId.empty())
+    std::vector<std::string> missing;
+    for (ConversationTree::Handle handle : handles)
+        if (!tree[handle].contentLoaded && !fetched.count(tree[handle].id))
+            missing.push_back(tree[handle].id);
+    if (!missing.empty())
+        fetched.merge(conversationManager.loadNodeContents(missing));
+    for (ConversationTree::Handle handle : handles)
+    {
+        ConversationNode &node = tree[handle];
+        if (node.contentLoaded)
+            continue;
+        auto it = fetched.find(node.id);
+        if (it != fetched.end())
+            node.content = ConversationNode::makeContent(std::move(it->second));
+        node.contentLoaded = true;
+    }
+
+    for (ConversationTree::Handle handle : handles)
     {
-        ConversationNode *node = findNode(currentId);
-        if (!node)
+        if (tree[handle].isNew)
+            continue;
+        auto it = contentLruIndex.find(handle);
+        if (it != contentLruIndex.end())
+            contentLru.splice(contentLru.begin(), contentLru, it->second);
+        else
+            contentLruIndex[handle] = contentLru.insert(contentLru.begin(), handle);
+    }
+
+    size_t capacity = handles.size() + CONTENT_CACHE_SIZE;
+    while (contentLru.size() > capacity)
+    {
+        ConversationTree::Handle handle = contentLru.back();
+        contentLru.pop_back();
+        contentLruIndex.erase(handle);
+        ConversationNode &node = tree[handle];
+        // Unsaved text and the reply being streamed stay in memory
+        if (node.isNew || node.dirty || handle == currentNode)
+            continue;
+        node.dropContent();
+    }
+}
+void AI::forgetContent(ConversationTree::Handle handle)
+{
+    auto it = contentLruIndex.find(handle);
+    if (it == contentLruIndex.end())
+        return;
+    contentLru.erase(it->second);
+    contentLruIndex.erase(it);
+}
+
+// The root system prompt followed by the most recent turns that fit in
+// budget tokens. Only walks back as far as the budget reaches, so the cost
+// does not grow with the conversation. Caller holds stateMutex exclusively
+// since token estimates are cached on the nodes.
+std::vector<ConversationTree::Handle> AI::getContextPath(ConversationTree::Handle handle, size_t budget)
+{
+    std::vector<ConversationTree::Handle> path;
+    if (!tree.contains(handle))
+        return path;
+    bool hasRoot = tree.contains(rootNode);
+    size_t usedTokens = hasRoot ? tree[rootNode].tokenCount() + MESSAGE_TOKEN_OVERHEAD : 0;
+    bool trimmed = false;
+    for (ConversationTree::Handle node = handle; node != ConversationTree::NONE && node != rootNode; node = tree[node].parent)
+    {
+        size_t tokens = tree[node].tokenCount() + MESSAGE_TOKEN_OVERHEAD;
+        if (!path.empty() && usedTokens + tokens > budget)
+        {
+            trimmed = true;
             break;
-        path.push_back(*node);
-        currentId = node->parentId;
+        }
+        usedTokens += tokens;
+        path.push_back(node);
     }
+    // A trimmed history still opens with a user turn
+    while (trimmed && path.size() > 1 && tree[path.back()].role != ConversationNode::ROLE_USER)
+        path.pop_back();
+    if (hasRoot)
+        path.push_back(rootNode);
     std::reverse(path.begin(), path.end());
+    loadContent(path);
     return path;
 }
 
 void AI::addNode(ConversationNode::ROLE role, std::string content)
 {
     std::unique_lock<std::shared_mutex> stateLock(stateMutex);
-    std::string nodeId = strUtils::randomId();
-    ConversationNode *parent = findNode(currentNodeId);
-    if (parent)
-        parent->childIds.push_back(nodeId);
-    nodeMap[nodeId] = std::make_unique<ConversationNode>(nodeId, role, content, currentNodeId);
-    currentNodeId = nodeId;
+    currentNode = addToTree(ConversationNode(strUtils::randomId(), role, std::move(content)), currentNode);
     stateLock.unlock();
     saveConversation();
 }
@@ -88,19 +210,23 @@ void AI::addNode(ConversationNode::ROLE role, std::string content)
 bool AI::deleteNode(const std::string &nodeId)
 {
     std::unique_lock<std::shared_mutex> stateLock(stateMutex);
-    ConversationNode *node = findNode(nodeId);
-    if (!node)
+    ConversationTree::Handle handle = tree.find(nodeId);
+    if (handle == ConversationTree::NONE || handle == rootNode)
         return false;
-    ConversationNode *parent = findNode(node->parentId);
-    if (parent)
-    {
-        auto it = std::find(parent->childIds.begin(), parent->childIds.end(), nodeId);
-        if (it != parent->childIds.end())
-            parent->childIds.erase(it);
-    }
-    nodeMap.erase(nodeId);
-    if (currentNodeId == nodeId)
-        currentNodeId = node->parentId;
+    ConversationTree::Handle parent = tree[handle].parent;
+
+    // The whole subtree goes, otherwise its nodes would be left without a parent
+    bool currentRemoved = false;
+    tree.removeSubtree(handle, [&](ConversationTree::Handle removed, const ConversationNode &node)
+                       {
+                           if (!node.isNew)
+                               deletedNodeIds.push_back(node.id);
+                           if (node.role != ConversationNode::ROLE_SYSTEM)
+                               messageCount--;
+                           currentRemoved |= removed == currentNode;
+                           forgetContent(removed); });
+    if (currentRemoved)
+        currentNode = parent;
     stateLock.unlock();
     saveConversation();
     return true;
@@ -109,38 +235,62 @@ bool AI::deleteNode(const std::string &nodeId)
 bool AI::switchNode(const std::string &nodeId)
 {
     std::unique_lock<std::shared_mutex> stateLock(stateMutex);
-    ConversationNode *node = findNode(nodeId);
-    if (node)
-    {
-        currentNodeId = nodeId;
-        return true;
-    }
-    return false;
+    ConversationTree::Handle handle = tree.find(nodeId);
+    if (handle == ConversationTree::NONE)
+        return false;
+    currentNode = handle;
+    return true;
 }
 
 std::vector<std::string> AI::getChildren(const std::string &nodeId)
 {
     std::shared_lock<std::shared_mutex> stateLock(stateMutex);
-    ConversationNode *node = findNode(nodeId);
-    if (node)
-        return node->childIds;
-    return {};
+    ConversationTree::Handle handle = tree.find(nodeId);
+    if (handle == ConversationTree::NONE)
+        return {};
+    return tree.view(handle).childIds;
 }
 
-std::vector<ConversationNode> AI::getCurrentPath()
+std::vector<ConversationNodeView> AI::getCurrentPath()
 {
-    std::shared_lock<std::shared_mutex> stateLock(stateMutex);
-    return getPathFromRoot(currentNodeId);
+    // Missing bodies are read from storage without the state lock, so a page
+    // render does not hold up streamed replies; the exclusive lock is only
+    // taken to put them in place and build the views
+    std::vector<std::string> missing;
+    {
+        std::shared_lock<std::shared_mutex> stateLock(stateMutex);
+        if (tree.contains(currentNode))
+            for (ConversationTree::Handle handle : tree.pathTo(currentNode))
+                if (!tree[handle].contentLoaded)
+                    missing.push_back(tree[handle].id);
+    }
+    std::unordered_map<std::string, std::string> fetched;
+    if (!missing.empty())
+        fetched = conversationManager.loadNodeContents(missing);
+
+    // The path is taken again, as it may have changed in between; node ids
+    // are never reused, so whatever was fetched for them still applies
+    std::unique_lock<std::shared_mutex> stateLock(stateMutex);
+    if (!tree.contains(currentNode))
+        return {};
+    std::vector<ConversationTree::Handle> handles = tree.pathTo(currentNode);
+    loadContent(handles, std::move(fetched));
+
+    std::vector<ConversationNodeView> path;
+    path.reserve(handles.size());
+    for (ConversationTree::Handle node : handles)
+        path.push_back(tree.view(node));
+    return path;
 }
 std::string AI::getCurrentNodeId() const
 {
     std::shared_lock<std::shared_mutex> stateLock(stateMutex);
-    return currentNodeId;
+    return tree.contains(currentNode) ? tree[currentNode].id : "";
 }
 std::string AI::getRootNodeId() const
 {
     std::shared_lock<std::shared_mutex> stateLock(stateMutex);
-    return rootNodeId;
+    return tree.contains(rootNode) ? tree[rootNode].id : "";
 }
 std::string AI::getConversationId() const
 {
@@ -150,17 +300,73 @@ std::string AI::getConversationId() const
 
 void AI::saveConversation()
 {
-    std::shared_lock<std::shared_mutex> stateLock(stateMutex);
-    if (!conversationId.empty())
+    // Changes are collected and their flags cleared under the state lock; the
+    // database write happens outside it and restores the flags if it fails
+    std::string savedConversationId;
+    ConversationChanges changes;
+    {
+        std::unique_lock<std::shared_mutex> stateLock(stateMutex);
+        if (conversationId.empty())
+            return;
+        savedConversationId = conversationId;
+        changes.messageCount = messageCount;
+        for (ConversationTree::Handle handle : changedNodes)
+        {
+            // Removed or already saved nodes are skipped, as is a repeat of a handle
+            // whose flags the first occurrence cleared
+            if (!tree.contains(handle))
+                continue;
+            ConversationNode &node = tree[handle];
+            if (!node.isNew && !node.dirty)
+                continue;
+            ConversationChanges::Node record{node.id, node.parent != ConversationTree::NONE ? tree[node.parent].id : "",
+                                             node.role, node.stopReason, node.content, node.contentLoaded};
+            (node.isNew ? changes.inserted : changes.updated).push_back(std::move(record));
+            node.isNew = node.dirty = false;
+        }
+        changedNodes.clear();
+        changes.deleted.swap(deletedNodeIds);
+        if (tree.contains(currentNode))
+        {
+            ConversationNode &current = tree[currentNode];
+            if (!current.contentLoaded)
+                loadContent({currentNode});
+            if (current.role != ConversationNode::ROLE_SYSTEM)
+                changes.preview = strUtils::utf8Prefix(*current.content, ConversationManager::PREVIEW_LENGTH);
+        }
+    }
+
+    try
     {
-        conversationManager.saveConversation(conversationId, nodeMap);
+        conversationManager.saveConversation(savedConversationId, changes);
+    }
+    catch (const std::exception &)
+    {
+        std::unique_lock<std::shared_mutex> stateLock(stateMutex);
+        if (conversationId == savedConversationId)
+        {
+            for (const auto &node : changes.inserted)
+                if (ConversationTree::Handle restored = tree.find(node.id); restored != ConversationTree::NONE)
+                {
+                    markChanged(restored);
+                    tree[restored].isNew = true;
+                }
+            for (const auto &node : changes.updated)
+                if (ConversationTree::Handle restored = tree.find(node.id); restored != ConversationTree::NONE)
+                {
+                    markChanged(restored);
+                    tree[restored].dirty = true;
+                }
+            deletedNodeIds.insert(deletedNodeIds.end(), changes.deleted.begin(), changes.deleted.end());
+        }
+        throw;
     }
 }
 
-std::vector<ConversationInfo> AI::getConversationList()
+std::vector<ConversationInfo> AI::getConversationList(long long afterUpdatedAt, const std::string &afterId, size_t limit)
 {
     std::lock_guard<std::mutex> conversationLock(conversationMutex);
-    return conversationManager.getConversationList();
+    return conversationManager.getConversationList(afterUpdatedAt, afterId, limit);
 }
 
 void AI::createConversation(const std::string &title)
@@ -172,12 +378,11 @@ void AI::createConversation(const std::string &title)
     {
         std::unique_lock<std::shared_mutex> stateLock(stateMutex);
         conversationId = newConversationId;
-        nodeMap.clear();
+        resetTree();
 
         std::lock_guard<std::mutex> settingsLock(settingsMutex);
-        currentNodeId = rootNodeId = strUtils::randomId();
-        nodeMap[currentNodeId] = std::make_unique<ConversationNode>(
-            currentNodeId, ConversationNode::ROLE_SYSTEM, systemPrompt, "");
+        currentNode = rootNode = addToTree(ConversationNode(strUtils::randomId(), ConversationNode::ROLE_SYSTEM, systemPrompt),
+                                           ConversationTree::NONE);
     }
     saveConversation();
 }
@@ -186,24 +391,21 @@ void AI::loadConversation(const std::string &conversationId)
 {
     std::lock_guard<std::mutex> conversationLock(conversationMutex);
     std::unique_lock<std::shared_mutex> stateLock(stateMutex);
-    this->conversationId = conversationId;
-    conversationManager.loadConversation(conversationId, nodeMap, rootNodeId, currentNodeId);
+    loadTree(conversationId);
 }
 
 void AI::deleteConversation(const std::string &conversationId)
 {
+    stopGeneration(conversationId);
     std::lock_guard<std::mutex> conversationLock(conversationMutex);
     conversationManager.deleteConversation(conversationId);
 
     std::unique_lock<std::shared_mutex> stateLock(stateMutex);
     if (this->conversationId == conversationId)
     {
-        auto conversations = conversationManager.getConversationList();
+        auto conversations = conversationManager.getConversationList(LLONG_MAX, "", 1);
         if (!conversations.empty())
-        {
-            this->conversationId = conversations[0].id;
-            conversationManager.loadConversation(this->conversationId, nodeMap, rootNodeId, currentNodeId);
-        }
+            loadTree(conversations[0].id);
         else
         {
             stateLock.unlock();
@@ -218,233 +420,625 @@ void AI::updateConversationTitle(const std::string &conversationId, const std::s
     conversationManager.updateConversationTitle(conversationId, title);
 }
 
+std::vector<SearchResult> AI::searchConversations(const std::string &query, size_t limit)
+{
+    return conversationManager.searchConversations(query, limit);
+}
+
+std::string AI::readNodeContent(const std::string &nodeId, size_t offset, size_t length,
+                                size_t &totalLength, size_t &nextOffset)
+{
+    std::lock_guard<std::mutex> conversationLock(conversationMutex);
+    return conversationManager.readNodeContent(nodeId, offset, length, totalLength, nextOffset);
+}
+
 void AI::setSettings(const std::string &apiKey, const std::string &baseUrl,
                      const std::string &model, int maxTokens,
-                     double temperature, double topP, std::string systemPrompt)
+                     double temperature, double topP, std::string systemPrompt,
+                     int contextTokens)
 {
     std::lock_guard<std::mutex> settingsLock(settingsMutex);
+    if (apiKey != this->apiKey || baseUrl != this->baseUrl)
+    {
+        // Answers for the old account or server are never served again
+        credentials = strUtils::hash128(baseUrl + '\0' + apiKey);
+        std::lock_guard<std::mutex> cacheLock(endpointCacheMutex);
+        endpointCache.clear();
+        conversationManager.clearApiCache();
+    }
     this->apiKey = apiKey, this->baseUrl = baseUrl;
     this->model = model, this->maxTokens = maxTokens;
     this->temperature = temperature, this->topP = topP, this->systemPrompt = systemPrompt;
-    conversationManager.saveApiSettings(apiKey, baseUrl, model, maxTokens, temperature, topP, systemPrompt);
+    this->contextTokens = contextTokens;
+    conversationManager.saveApiSettings(apiKey, baseUrl, model, maxTokens, temperature, topP, systemPrompt, contextTokens);
 }
 SettingsResponse AI::getSettings() const
 {
     std::lock_guard<std::mutex> settingsLock(settingsMutex);
     return SettingsResponse(apiKey, baseUrl,
                             model, maxTokens,
-                            temperature, topP, systemPrompt);
+                            temperature, topP, systemPrompt,
+                            contextTokens);
 }
 
 std::string AI::generateResponse(AIStreamCallback streamCallback)
+{
+    return generateReplies(1, [&streamCallback](const std::string &conversationId, const std::string &nodeId,
+                                                size_t, const std::string &messageDelta)
+                           { streamCallback(conversationId, nodeId, messageDelta); })[0];
+}
+std::vector<std::string> AI::generateAlternatives(size_t count, AIBranchStreamCallback streamCallback)
+{
+    ASSERT(count > 0 && count <= MAX_ALTERNATIVES);
+    return generateReplies(count, streamCallback);
+}
+
+std::vector<std::string> AI::generateReplies(size_t count, AIBranchStreamCallback streamCallback)
 {
     nlohmann::json requestJson;
+    size_t contextBudget;
+    std::string currentApiKey, currentBaseUrl;
+    bool deterministic, hedged;
+    double currentHedgePercentile;
     {
         std::lock_guard<std::mutex> settingsLock(settingsMutex);
+        contextBudget = contextTokens > maxTokens ? contextTokens - maxTokens : 0;
+        deterministic = temperature == 0;
         requestJson["model"] = model;
         requestJson["max_tokens"] = maxTokens;
         requestJson["temperature"] = temperature;
         requestJson["top_p"] = topP;
+        currentApiKey = apiKey;
+        currentBaseUrl = baseUrl;
+        // Alternatives already run side by side; only a lone reply is hedged
+        hedged = count == 1 && hedgeEnabled;
+        currentHedgePercentile = hedgePercentile;
     }
 
     requestJson["stream"] = true;
+    std::string parameters = requestJson.dump();
 
-    const std::string_view roleString[3] = {"user", "assistant", "system"};
-    nlohmann::json messagesArray = nlohmann::json::array();
-
+    // The messages are spliced in from each node's cached fragment, into one
+    // buffer sized up front; only nodes whose content changed are serialized
+    std::string requestBody;
+    GenerationSession session;
     {
-        std::shared_lock<std::shared_mutex> stateLock(stateMutex);
-        for (const auto &msg : getPathFromRoot(currentNodeId))
-            messagesArray.push_back({{"role", roleString[msg.role]},
-                                     {"content", msg.content}});
+        std::unique_lock<std::shared_mutex> stateLock(stateMutex);
+        std::vector<ConversationTree::Handle> path = getContextPath(currentNode, contextBudget);
+        size_t bodySize = parameters.size() + MESSAGES_FRAMING.size() + 2;
+        for (ConversationTree::Handle handle : path)
+            bodySize += tree[handle].messageFragment().size() + 1;
+        requestBody.reserve(bodySize);
+        requestBody.append(parameters, 0, parameters.size() - 1);
+        requestBody += MESSAGES_FRAMING;
+        for (size_t i = 0; i < path.size(); i++)
+        {
+            if (i > 0)
+                requestBody += ',';
+            requestBody += tree[path[i]].messageFragment();
+        }
+        requestBody += "]}";
+        session.conversationId = conversationId;
+        if (tree.contains(currentNode))
+            session.parentId = tree[currentNode].id;
     }
 
-    requestJson["messages"] = messagesArray;
-
-    std::string fullAssistantResponse;
-    std::mutex responseMutex;
-    bool wasCancelled = false;
-    bool responseStarted = false;
-    std::string assistantNodeId;
-    ConversationNode::STOP_REASON finalStopReason = ConversationNode::STOP_REASON_NONE;
-
-    std::shared_ptr<std::atomic<bool>> cancellationToken;
+    std::vector<std::unique_ptr<ReplyStream>> &replies = session.replies;
+    for (size_t branch = 0; branch < count; branch++)
     {
-        std::lock_guard<std::mutex> cancelLock(requestCancelMutex);
-        currentRequestCancelled = std::make_shared<std::atomic<bool>>(false);
-        cancellationToken = currentRequestCancelled;
+        auto reply = std::make_unique<ReplyStream>();
+        reply->session = &session;
+        reply->branch = branch;
+        reply->cancelled = std::make_shared<CancellationToken>();
+        reply->started = std::chrono::steady_clock::now();
+        reply->writtenAtStart = WriteCounter::bytesWritten();
+        replies.push_back(std::move(reply));
     }
+    {
+        std::lock_guard<std::mutex> sessionLock(sessionMutex);
+        if (!sessions.emplace(session.conversationId, &session).second)
+            throw std::runtime_error("A reply is already being generated in this conversation");
+    }
+    // The session stays registered until its replies are settled, however this returns
+    struct SessionScope
+    {
+        AI *ai;
+        GenerationSession *session;
+        ~SessionScope() { ai->endSession(*session); }
+    } sessionScope{this, &session};
 
-    StreamCallback packedStreamCallback = [&fullAssistantResponse, &responseMutex, &wasCancelled, &responseStarted, &assistantNodeId, &finalStopReason, cancellationToken, streamCallback, this](const std::string &chunk)
+    // Only a single reply at temperature 0 is worth caching; alternatives are asked for to differ
+    std::string endpoint = currentBaseUrl + "chat/completions";
+    std::string cacheKey;
+    if (count == 1 && deterministic && responseCache.isEnabled())
     {
-        if (cancellationToken->load())
+        cacheKey = ResponseCache::key(endpoint, requestBody);
+        ResponseCache::Entry entry;
+        if (responseCache.lookup(cacheKey, entry))
         {
-            wasCancelled = true;
-            finalStopReason = ConversationNode::STOP_REASON_USER_STOPPED;
-            return;
+            ReplyStream &reply = *replies[0];
+            for (size_t offset = 0; offset < entry.content.size();)
+            {
+                size_t end = std::min(entry.content.size(), offset + REPLAY_CHUNK_BYTES);
+                while (end < entry.content.size() && (static_cast<unsigned char>(entry.content[end]) & 0xC0) == 0x80)
+                    end++;
+                appendReply(reply, entry.content.substr(offset, end - offset), streamCallback);
+                offset = end;
+            }
+            finishReply(reply, entry.stopReason, true);
+            return {entry.content};
         }
+    }
 
-        if (chunk.empty() || chunk == "[DONE]")
-            return;
+    std::vector<std::pair<std::string, FetchOptions>> requests;
+    requests.reserve(count);
+    for (const auto &reply : replies)
+    {
+        ReplyStream *stream = reply.get();
+        // The last request takes the body over; only extra alternatives copy it
+        requests.emplace_back(endpoint,
+                              FetchOptions("POST",
+                                           {{"Content-Type", "application/json"},
+                                            {"Authorization", "Bearer " + currentApiKey},
+                                            {"Accept", "text/event-stream"}},
+                                           stream->branch + 1 == count ? std::move(requestBody) : requestBody,
+                                           true,
+                                           [this, stream, &streamCallback](const SseEvent &event)
+                                           { onStreamEvent(*stream, event, streamCallback); },
+                                           0,
+                                           stream->cancelled));
+        // A stream that stalls mid-reply still has its pending text flushed on time
+        requests.back().second.tickCallback = [this, stream]()
+        {
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            if (std::chrono::steady_clock::now() - stream->lastFlush >= STREAM_FLUSH_INTERVAL)
+                flushReply(*stream);
+        };
+        requests.back().second.tickIntervalMs = STREAM_FLUSH_INTERVAL.count();
+    }
+    if (hedged)
+    {
+        replies[0]->hedgeDelayMs = hedgeDelay(currentHedgePercentile).count();
+        requests[0].second.hedgeDelayMs = replies[0]->hedgeDelayMs;
+    }
+
+    std::vector<Response> responses;
+    try
+    {
+        responses = Fetch::fetchAll(requests);
+    }
+    catch (const std::exception &)
+    {
+        for (const auto &reply : replies)
+            finishReply(*reply, ConversationNode::STOP_REASON_ERROR);
+        throw;
+    }
 
-        nlohmann::json chunkJson = nlohmann::json::parse(chunk);
-        auto choice = chunkJson["choices"][0];
+    for (size_t branch = 0; branch < count; branch++)
+        replies[branch]->attempts = std::move(responses[branch].attempts);
 
-        if (choice["finish_reason"].is_string())
+    // Each reply is settled on its own; the call fails only when none of them got through
+    std::vector<std::string> results;
+    std::exception_ptr firstError;
+    size_t failed = 0;
+    for (size_t branch = 0; branch < count; branch++)
+    {
+        ReplyStream &reply = *replies[branch];
+        const Response &response = responses[branch];
+        std::exception_ptr error;
+        if (reply.wasCancelled || reply.cancelled->isCancelled())
+            finishReply(reply, ConversationNode::STOP_REASON_USER_STOPPED);
+        else if (response.curlCode != CURLE_OK)
         {
-            std::string finishReason = choice["finish_reason"];
-            if (finishReason == "stop")
-                finalStopReason = ConversationNode::STOP_REASON_STOP;
-            else if (finishReason == "length")
-                finalStopReason = ConversationNode::STOP_REASON_LENGTH;
-            else if (finishReason == "content_filter")
-                finalStopReason = ConversationNode::STOP_REASON_CONTENT_FILTER;
-            else
-                finalStopReason = ConversationNode::STOP_REASON_ERROR;
+            finishReply(reply, ConversationNode::STOP_REASON_ERROR);
+            error = std::make_exception_ptr(CurlError(__FILE__, __LINE__, response.curlCode));
         }
-
-        std::string content = "";
-        if (choice["delta"]["reasoning_content"].is_string())
-            content += choice["delta"]["reasoning_content"];
-        if (choice["delta"]["content"].is_string())
-            content += choice["delta"]["content"];
-        if (content != "")
+        else if (!response.ok)
         {
+            finishReply(reply, ConversationNode::STOP_REASON_ERROR);
+            error = std::make_exception_ptr(NetworkError(__FILE__, __LINE__, response.status));
+        }
+        else
+        {
+            finishReply(reply, reply.stopReason);
+            if (!cacheKey.empty() &&
+                (reply.stopReason == ConversationNode::STOP_REASON_STOP || reply.stopReason == ConversationNode::STOP_REASON_LENGTH))
             {
-                std::lock_guard<std::mutex> lock(responseMutex);
-                fullAssistantResponse += content;
+                std::lock_guard<std::mutex> lock(reply.mutex);
+                responseCache.store(cacheKey, reply.fullResponse, reply.stopReason);
+            }
+        }
 
-                if (!responseStarted && !content.empty())
+        if (error)
+        {
+            failed++;
+            if (!firstError)
+                firstError = error;
+            if (count > 1)
+            {
+                try
                 {
-                    responseStarted = true;
-                    std::unique_lock<std::shared_mutex> stateLock(stateMutex);
-                    assistantNodeId = strUtils::randomId();
-                    ConversationNode *parent = findNode(currentNodeId);
-                    if (parent)
-                        parent->childIds.push_back(assistantNodeId);
-                    nodeMap[assistantNodeId] = std::make_unique<ConversationNode>(assistantNodeId, ConversationNode::ROLE_ASSISTANT, fullAssistantResponse, currentNodeId);
-                    currentNodeId = assistantNodeId;
-                    stateLock.unlock();
-                    saveConversation();
+                    std::rethrow_exception(error);
                 }
-                else if (responseStarted && !assistantNodeId.empty())
+                catch (const std::exception &e)
                 {
-                    std::unique_lock<std::shared_mutex> stateLock(stateMutex);
-                    ConversationNode *assistantNode = findNode(assistantNodeId);
-                    if (assistantNode)
-                        assistantNode->content = fullAssistantResponse;
-                    stateLock.unlock();
-                    saveConversation();
+                    std::cerr << "Alternative " << branch << " failed: " << e.what() << std::endl;
                 }
             }
-            streamCallback(content);
         }
-    };
+        std::lock_guard<std::mutex> lock(reply.mutex);
+        results.push_back(reply.fullResponse);
+    }
+    if (failed == count)
+        std::rethrow_exception(firstError);
+    return results;
+}
 
-    std::string currentApiKey, currentBaseUrl;
+void AI::onStreamEvent(ReplyStream &reply, const SseEvent &event, const AIBranchStreamCallback &streamCallback)
+{
+    if (reply.cancelled->isCancelled())
     {
-        std::lock_guard<std::mutex> settingsLock(settingsMutex);
-        currentApiKey = apiKey;
-        currentBaseUrl = baseUrl;
+        reply.wasCancelled = true;
+        reply.stopReason = ConversationNode::STOP_REASON_USER_STOPPED;
+        return;
     }
 
-    Response response = Fetch::fetch(currentBaseUrl + "chat/completions",
-                                     FetchOptions("POST",
-                                                  {{"Content-Type", "application/json"},
-                                                   {"Authorization", "Bearer " + currentApiKey},
-                                                   {"Accept", "text/event-stream"}},
-                                                  requestJson.dump(),
-                                                  true,
-                                                  packedStreamCallback,
-                                                  0,
-                                                  cancellationToken));
+    if (event.data.empty() || event.data == "[DONE]")
+        return;
+
+    StreamDelta &delta = reply.delta;
+    delta.parse(event.data);
+
+    if (delta.hasFinishReason)
     {
-        std::lock_guard<std::mutex> cancelLock(requestCancelMutex);
-        currentRequestCancelled = nullptr;
+        if (delta.finishReason == "stop")
+            reply.stopReason = ConversationNode::STOP_REASON_STOP;
+        else if (delta.finishReason == "length")
+            reply.stopReason = ConversationNode::STOP_REASON_LENGTH;
+        else if (delta.finishReason == "content_filter")
+            reply.stopReason = ConversationNode::STOP_REASON_CONTENT_FILTER;
+        else
+            reply.stopReason = ConversationNode::STOP_REASON_ERROR;
     }
-    if (wasCancelled || cancellationToken->load())
+
+    std::string content = delta.reasoningContent + delta.content;
+    if (!content.empty())
+        appendReply(reply, content, streamCallback);
+}
+void AI::appendReply(ReplyStream &reply, const std::string &content, const AIBranchStreamCallback &streamCallback)
+{
     {
-        std::lock_guard<std::mutex> lock(responseMutex);
-        if (responseStarted && !assistantNodeId.empty())
+        std::lock_guard<std::mutex> lock(reply.mutex);
+        reply.fullResponse += content;
+        if (reply.firstToken == std::chrono::steady_clock::time_point{})
+            reply.firstToken = std::chrono::steady_clock::now();
+
+        if (reply.nodeId.empty())
         {
+            // The node appears with the first text, as a child of the node the
+            // request was made from; the first reply to start becomes current.
+            // Once another conversation is loaded it goes straight to storage.
+            const GenerationSession &session = *reply.session;
+            std::string nodeId = strUtils::randomId();
+            auto persistStart = std::chrono::steady_clock::now();
+            bool created;
             std::unique_lock<std::shared_mutex> stateLock(stateMutex);
-            ConversationNode *assistantNode = findNode(assistantNodeId);
-            if (assistantNode)
+            if (conversationId == session.conversationId)
+            {
+                ConversationTree::Handle parent = tree.find(session.parentId);
+                created = parent != ConversationTree::NONE;
+                if (created)
+                {
+                    ConversationTree::Handle node = addToTree(ConversationNode(nodeId, ConversationNode::ROLE_ASSISTANT, reply.fullResponse), parent);
+                    if (currentNode == parent)
+                        currentNode = node;
+                }
+                stateLock.unlock();
+                if (created)
+                    saveConversation();
+            }
+            else
             {
-                assistantNode->stopReason = ConversationNode::STOP_REASON_USER_STOPPED;
+                stateLock.unlock();
+                created = conversationManager.saveNode(session.conversationId,
+                                                       {nodeId, session.parentId, ConversationNode::ROLE_ASSISTANT,
+                                                        ConversationNode::STOP_REASON_NONE,
+                                                        ConversationNode::makeContent(reply.fullResponse), true});
             }
-            stateLock.unlock();
-            saveConversation();
+            if (!created)
+            {
+                reply.cancelled->cancel();
+                return;
+            }
+            reply.nodeId = nodeId;
+            conversationManager.beginDraft(session.conversationId, reply.nodeId, reply.fullResponse);
+            reply.lastFlush = std::chrono::steady_clock::now();
+            reply.persistUs += std::chrono::duration_cast<std::chrono::microseconds>(reply.lastFlush - persistStart).count();
+        }
+        else
+        {
+            // The node row itself is rewritten once, when the reply ends
+            reply.pendingContent += content;
+            if (reply.pendingContent.size() >= STREAM_FLUSH_BYTES ||
+                std::chrono::steady_clock::now() - reply.lastFlush >= STREAM_FLUSH_INTERVAL)
+                flushReply(reply);
         }
-        return fullAssistantResponse;
     }
-    if (!response.isOk())
-        THROW_NETWORK_ERROR(response.status);
+    streamCallback(reply.session->conversationId, reply.nodeId, reply.branch, content);
+}
+
+// Caller holds reply.mutex and stateMutex exclusively. Brings the reply's
+// node up to the text received so far when its conversation is loaded; that
+// also covers a node reloaded from storage mid-stream, which lacks the draft.
+void AI::applyReply(ReplyStream &reply)
+{
+    if (conversationId != reply.session->conversationId)
+        return;
+    ConversationTree::Handle handle = tree.find(reply.nodeId);
+    if (handle == ConversationTree::NONE)
+        return;
+    ConversationNode &node = tree[handle];
+    // Views and the cached message hold references of their own; with none
+    // out, only this reply and the node share the buffer and it can grow in place
+    if (node.content == reply.nodeContent && reply.nodeContent.use_count() == 2)
+        reply.nodeContent->append(reply.pendingContent);
+    else if (node.contentLoaded && node.content->size() == reply.fullResponse.size())
+        return;
+    else
+    {
+        reply.nodeContent = std::make_shared<std::string>(reply.fullResponse);
+        node.content = reply.nodeContent;
+    }
+    node.contentLoaded = true;
+    markChanged(handle);
+    node.dirty = true;
+}
+// Caller holds reply.mutex
+void AI::flushReply(ReplyStream &reply)
+{
+    reply.lastFlush = std::chrono::steady_clock::now();
+    if (reply.pendingContent.empty() || reply.nodeId.empty())
+        return;
+    auto persistStart = reply.lastFlush;
+    {
+        std::unique_lock<std::shared_mutex> stateLock(stateMutex);
+        applyReply(reply);
+    }
+    conversationManager.appendDraft(reply.nodeId, reply.pendingContent);
+    reply.pendingContent.clear();
+    reply.persistUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - persistStart).count();
+}
 
+// Writes out the reply with how it ended, retires its draft and records
+// how the generation went. The text still pending skips the draft: the whole
+// reply is stored with its stop reason in one transaction, so a stopped reply
+// is stored with STOP_REASON_USER_STOPPED or not at all. This goes to
+// storage directly, whether or not the conversation is still loaded.
+void AI::finishReply(ReplyStream &reply, ConversationNode::STOP_REASON stopReason, bool cached)
+{
+    std::lock_guard<std::mutex> lock(reply.mutex);
+    if (!reply.nodeId.empty())
     {
-        std::lock_guard<std::mutex> lock(responseMutex);
-        if (!responseStarted && !fullAssistantResponse.empty())
+        auto persistStart = std::chrono::steady_clock::now();
+        const GenerationSession &session = *reply.session;
+        ConversationChanges::Node record{reply.nodeId, session.parentId, ConversationNode::ROLE_ASSISTANT, stopReason,
+                                         ConversationNode::makeContent(reply.fullResponse), true};
+        reply.pendingContent.clear();
+        bool deleted;
         {
-            addNode(ConversationNode::ROLE_ASSISTANT, fullAssistantResponse);
+            // In the loaded conversation a missing node was deleted while it streamed
+            std::shared_lock<std::shared_mutex> stateLock(stateMutex);
+            deleted = conversationId == session.conversationId && tree.find(reply.nodeId) == ConversationTree::NONE;
         }
-        else if (responseStarted && !assistantNodeId.empty() && finalStopReason != ConversationNode::STOP_REASON_NONE)
+        if (!deleted && conversationManager.saveNode(session.conversationId, record))
         {
             std::unique_lock<std::shared_mutex> stateLock(stateMutex);
-            ConversationNode *assistantNode = findNode(assistantNodeId);
-            if (assistantNode)
+            ConversationTree::Handle handle = conversationId == session.conversationId ? tree.find(reply.nodeId)
+                                                                                       : ConversationTree::NONE;
+            if (handle != ConversationTree::NONE)
             {
-                assistantNode->stopReason = finalStopReason;
+                ConversationNode &node = tree[handle];
+                node.content = record.content;
+                node.contentLoaded = true;
+                node.stopReason = stopReason;
+                node.isNew = node.dirty = false;
             }
-            stateLock.unlock();
-            saveConversation();
         }
-        return fullAssistantResponse;
+        conversationManager.discardDraft(reply.nodeId);
+        reply.persistUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - persistStart).count();
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto elapsedUs = [](std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+    { return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(to - from).count(); };
+    GenerationSample sample;
+    sample.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+    if (reply.firstToken != std::chrono::steady_clock::time_point{})
+        sample.firstTokenUs = elapsedUs(reply.started, reply.firstToken);
+    sample.totalUs = elapsedUs(reply.started, now);
+    sample.tokens = strUtils::estimateTokens(reply.fullResponse);
+    sample.persistUs = reply.persistUs;
+    sample.bytesWritten = WriteCounter::bytesWritten() - reply.writtenAtStart;
+    std::chrono::steady_clock::time_point stopRequested;
+    {
+        std::lock_guard<std::mutex> sessionLock(sessionMutex);
+        stopRequested = reply.stopRequested;
     }
+    if (stopRequested != std::chrono::steady_clock::time_point{})
+        sample.cancelLatencyUs = elapsedUs(stopRequested, now);
+    sample.stopReason = stopReason;
+    sample.cached = cached;
+    sample.hedgeDelayUs = reply.hedgeDelayMs * 1000;
+    if (!reply.attempts.empty())
+        sample.attempts = reply.attempts.size();
+    for (size_t i = 0; i < reply.attempts.size() && i < std::size(sample.attemptFirstByteUs); i++)
+    {
+        sample.attemptFirstByteUs[i] = reply.attempts[i].firstByteUs;
+        if (reply.attempts[i].won)
+            sample.winningAttempt = i;
+    }
+    GenerationStats::instance().record(sample);
+}
+
+std::chrono::milliseconds AI::hedgeDelay(double percentile) const
+{
+    double delayMs = GenerationStats::instance().firstTokenPercentileMs(percentile, HEDGE_MIN_SAMPLES);
+    if (delayMs == 0)
+        return HEDGE_DEFAULT_DELAY;
+    return std::clamp(std::chrono::milliseconds((long long)delayMs), HEDGE_MIN_DELAY, HEDGE_MAX_DELAY);
+}
+void AI::setHedging(bool enabled, double percentile)
+{
+    ASSERT(percentile > 0 && percentile <= 100);
+    std::lock_guard<std::mutex> settingsLock(settingsMutex);
+    hedgeEnabled = enabled;
+    hedgePercentile = percentile;
+    conversationManager.saveHedgeSettings(enabled, percentile);
+}
+AI::HedgeInfo AI::getHedging() const
+{
+    std::lock_guard<std::mutex> settingsLock(settingsMutex);
+    return HedgeInfo{hedgeEnabled, hedgePercentile, (size_t)hedgeDelay(hedgePercentile).count()};
 }
 
+void AI::setResponseCache(bool enabled, size_t capacityBytes)
+{
+    responseCache.configure(enabled, capacityBytes);
+}
+ResponseCache::Info AI::getResponseCacheInfo() const
+{
+    return responseCache.info();
+}
+void AI::clearResponseCache()
+{
+    responseCache.clear();
+}
+
+void AI::endSession(const GenerationSession &session)
+{
+    std::lock_guard<std::mutex> sessionLock(sessionMutex);
+    sessions.erase(session.conversationId);
+}
+// Caller holds sessionMutex
+void AI::cancelReply(ReplyStream &reply)
+{
+    if (!reply.cancelled->cancel())
+        return;
+    reply.stopRequested = std::chrono::steady_clock::now();
+}
 void AI::stopGeneration()
 {
-    std::lock_guard<std::mutex> cancelLock(requestCancelMutex);
-    if (currentRequestCancelled)
-        currentRequestCancelled->store(true);
+    stopGeneration(getConversationId());
+}
+bool AI::stopGeneration(const std::string &conversationId)
+{
+    std::lock_guard<std::mutex> sessionLock(sessionMutex);
+    auto it = sessions.find(conversationId);
+    if (it == sessions.end())
+        return false;
+    for (const auto &reply : it->second->replies)
+        cancelReply(*reply);
+    return true;
+}
+bool AI::stopAlternative(size_t branch)
+{
+    std::string loadedConversationId = getConversationId();
+    std::lock_guard<std::mutex> sessionLock(sessionMutex);
+    auto it = sessions.find(loadedConversationId);
+    if (it == sessions.end() || branch >= it->second->replies.size())
+        return false;
+    cancelReply(*it->second->replies[branch]);
+    return true;
 }
 
-std::vector<std::string> AI::getModels()
+// Returns the body of a GET on baseUrl + endpoint, from the cache when it
+// holds one for the current credentials
+std::string AI::fetchEndpoint(const std::string &endpoint, std::chrono::seconds ttl, bool refresh)
 {
-    std::string currentApiKey, currentBaseUrl;
+    std::string currentApiKey, currentBaseUrl, currentCredentials;
     {
         std::lock_guard<std::mutex> settingsLock(settingsMutex);
         currentApiKey = apiKey;
         currentBaseUrl = baseUrl;
+        currentCredentials = credentials;
     }
 
-    std::vector<std::string> modelIds;
-    Response response = Fetch::fetch(currentBaseUrl + "models",
-                                     FetchOptions("GET",
-                                                  {{"Authorization", "Bearer " + currentApiKey}}));
+    long long now = std::chrono::duration_cast<std::chrono::seconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count();
+    if (!refresh)
+    {
+        std::lock_guard<std::mutex> cacheLock(endpointCacheMutex);
+        auto cached = endpointCache.find(endpoint);
+        if (cached != endpointCache.end() && cached->second.credentials == currentCredentials)
+        {
+            if (now - cached->second.fetchedAt >= ttl.count() && refreshing.insert(endpoint).second)
+            {
+                refreshQueue.push_back(endpoint);
+                refreshCondition.notify_one();
+            }
+            return cached->second.body;
+        }
+    }
+
+    Response response = Fetch::fetch(currentBaseUrl + endpoint,
+                                      FetchOptions("GET",
+                                                   {{"Authorization", "Bearer " + currentApiKey}}));
     if (!response.isOk())
         THROW_NETWORK_ERROR(response.status);
-    nlohmann::json responseJson = response.json();
+    storeEndpoint(endpoint, CachedEndpoint(currentCredentials, response.body, now));
+    return response.body;
+}
+void AI::storeEndpoint(const std::string &endpoint, CachedEndpoint entry)
+{
+    // A response that arrives after the credentials changed is dropped
+    std::lock_guard<std::mutex> settingsLock(settingsMutex);
+    if (entry.credentials != credentials || !nlohmann::json::accept(entry.body))
+        return;
+    std::lock_guard<std::mutex> cacheLock(endpointCacheMutex);
+    conversationManager.saveApiCache(endpoint, entry);
+    endpointCache.insert_or_assign(endpoint, std::move(entry));
+}
+void AI::runRefreshes()
+{
+    std::unique_lock<std::mutex> cacheLock(endpointCacheMutex);
+    while (true)
+    {
+        refreshCondition.wait(cacheLock, [this]
+                              { return stopping || !refreshQueue.empty(); });
+        if (stopping)
+            return;
+        std::string endpoint = std::move(refreshQueue.back());
+        refreshQueue.pop_back();
+        cacheLock.unlock();
+        try
+        {
+            fetchEndpoint(endpoint, std::chrono::seconds::zero(), true);
+        }
+        catch (const std::exception &e)
+        {
+            // The stale entry stays and is retried on its next use
+            std::cerr << "Refreshing " << endpoint << " failed: " << e.what() << std::endl;
+        }
+        cacheLock.lock();
+        refreshing.erase(endpoint);
+    }
+}
+
+std::vector<std::string> AI::getModels(bool refresh)
+{
+    std::vector<std::string> modelIds;
+    nlohmann::json responseJson = nlohmann::json::parse(fetchEndpoint("models", MODELS_TTL, refresh));
     for (const auto &model : responseJson.at("data"))
         modelIds.push_back(model.at("id"));
     return modelIds;
 }
 
-float AI::getUserBalance()
+float AI::getUserBalance(bool refresh)
 {
-    std::string currentApiKey, currentBaseUrl;
-    {
-        std::lock_guard<std::mutex> settingsLock(settingsMutex);
-        currentApiKey = apiKey;
-        currentBaseUrl = baseUrl;
-    }
-
-    Response response = Fetch::fetch(currentBaseUrl + "user/balance",
-                                     FetchOptions("GET",
-                                                  {{"Authorization", "Bearer " + currentApiKey}}));
-    if (!response.isOk())
-        THROW_NETWORK_ERROR(response.status);
-    nlohmann::json responseJson = response.json();
+    nlohmann::json responseJson = nlohmann::json::parse(fetchEndpoint("user/balance", BALANCE_TTL, refresh));
     for (const auto &balanceInfo : responseJson.at("balance_infos"))
         if (balanceInfo.at("currency") == "CNY")
             return std::atof(std::string(balanceInfo.at("total_balance")).c_str());
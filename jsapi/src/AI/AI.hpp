@@ -18,73 +18,233 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <list>
 #include <functional>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <mutex>
 #include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
 #include <nlohmann/json.hpp>
 #include "Fetch.hpp"
 #include "ConversationInfo.hpp"
 #include "AICallback.hpp"
 #include "ConversationInfo.hpp"
 #include "ConversationManager.hpp"
+#include "ConversationTree.hpp"
+#include "ResponseCache.hpp"
+#include "GenerationStats.hpp"
+#include "StreamDelta.hpp"
 #include "SettingsResponse.hpp"
 
 class AI
 {
 private:
     ConversationManager conversationManager;
+    ResponseCache responseCache;
     std::string apiKey, baseUrl;
     std::string model = "deepseek-chat";
     int maxTokens = 1000;
     double temperature = 0.7;
     double topP = 1.0;
+    // Context window of the model; the prompt is trimmed to this minus maxTokens
+    int contextTokens = 65536;
     std::string systemPrompt = "你是一个有用的助手。请尽力回答问题。请不要使用任何 Markdown 语法或者表情符号等特殊字符来格式化回答。";
 
-    std::unordered_map<std::string, std::unique_ptr<ConversationNode>> nodeMap;
-    std::string currentNodeId, rootNodeId;
+    ConversationTree tree;
+    ConversationTree::Handle currentNode = ConversationTree::NONE, rootNode = ConversationTree::NONE;
     std::string conversationId;
+    // Saved nodes removed since the last save; deleted from the database by the next one
+    std::vector<std::string> deletedNodeIds;
+    // Nodes added or changed since the last save, so saving does not walk the
+    // whole tree; a handle may repeat or be stale and is checked on use
+    std::vector<ConversationTree::Handle> changedNodes;
+    // Non-system nodes in the tree, stored as the conversation's message count
+    int messageCount = 0;
+    // Stored nodes whose content is loaded, most recently used first. Beyond
+    // the nodes in use and CONTENT_CACHE_SIZE more, bodies are dropped again
+    // and refetched when needed.
+    std::list<ConversationTree::Handle> contentLru;
+    std::unordered_map<ConversationTree::Handle, std::list<ConversationTree::Handle>::iterator> contentLruIndex;
+    static constexpr size_t CONTENT_CACHE_SIZE = 64;
+
+    // Fingerprint of baseUrl and apiKey; cached endpoint responses only count
+    // while theirs matches
+    std::string credentials;
+
+    // Responses of the models and balance endpoints, mirrored in the settings
+    // database. Past its TTL an entry is still served, and a refresh is queued
+    // for refreshWorker unless one is pending already.
+    std::unordered_map<std::string, CachedEndpoint> endpointCache;
+    std::vector<std::string> refreshQueue;
+    std::unordered_set<std::string> refreshing;
+    bool stopping = false;
+    std::mutex endpointCacheMutex;
+    std::condition_variable refreshCondition;
+    std::thread refreshWorker;
+    static constexpr std::chrono::seconds MODELS_TTL{3600};
+    static constexpr std::chrono::seconds BALANCE_TTL{60};
 
     mutable std::shared_mutex stateMutex;
     mutable std::mutex settingsMutex;
     mutable std::mutex conversationMutex;
 
-    std::shared_ptr<std::atomic<bool>> currentRequestCancelled;
-    std::mutex requestCancelMutex;
+    // A streamed reply is applied to its node and draft once this much time
+    // has passed or this much text is pending; fetchAll's tick covers a stream
+    // that stalls between deltas, which bounds what a crash can lose of it
+    static constexpr std::chrono::milliseconds STREAM_FLUSH_INTERVAL{500};
+    static constexpr size_t STREAM_FLUSH_BYTES = 2048;
+    // Per-message framing the API adds on top of the content
+    static constexpr size_t MESSAGE_TOKEN_OVERHEAD = 4;
+    // A cached reply is replayed to the stream callback in pieces of about this size
+    static constexpr size_t REPLAY_CHUNK_BYTES = 64;
+    // Joins the parameter object to the message fragments in a request body
+    static constexpr std::string_view MESSAGES_FRAMING = ",\"messages\":[";
+    // Upper bound on the concurrent requests of one generateAlternatives call
+    static constexpr size_t MAX_ALTERNATIVES = 8;
+
+    // Hedging of single replies, under settingsMutex. The delay is the
+    // hedgePercentile of recent first-token times, clamped, or the default
+    // until there are enough of them.
+    bool hedgeEnabled = false;
+    double hedgePercentile = 95;
+    static constexpr std::chrono::milliseconds HEDGE_DEFAULT_DELAY{4000};
+    static constexpr std::chrono::milliseconds HEDGE_MIN_DELAY{500};
+    static constexpr std::chrono::milliseconds HEDGE_MAX_DELAY{15000};
+    static constexpr size_t HEDGE_MIN_SAMPLES = 10;
+
+    struct GenerationSession;
+    // One assistant reply of a session, streaming into its own node
+    struct ReplyStream
+    {
+        GenerationSession *session;
+        size_t branch;
+        std::string nodeId;
+        std::shared_ptr<CancellationToken> cancelled;
+        std::mutex mutex;
+        std::string fullResponse;
+        // Deltas collect here and reach the node and its draft in slices of at
+        // most STREAM_FLUSH_INTERVAL or STREAM_FLUSH_BYTES
+        std::string pendingContent;
+        // The node's content buffer while applyReply may still append to it
+        std::shared_ptr<std::string> nodeContent;
+        std::chrono::steady_clock::time_point lastFlush;
+        ConversationNode::STOP_REASON stopReason = ConversationNode::STOP_REASON_NONE;
+        bool wasCancelled = false;
+        StreamDelta delta;
+
+        // For GenerationStats; stopRequested is read and written under sessionMutex
+        std::chrono::steady_clock::time_point started, firstToken, stopRequested;
+        uint64_t persistUs = 0;
+        // WriteCounter::bytesWritten() when the reply started
+        uint64_t writtenAtStart = 0;
+        size_t hedgeDelayMs = 0;
+        std::vector<FetchAttempt> attempts;
+    };
 
-    ConversationNode *findNode(const std::string &nodeId);
-    std::vector<ConversationNode> getPathFromRoot(const std::string &nodeId);
+    // The replies one generation streams under a node of its conversation.
+    // A session outlives switching to another conversation: its replies then
+    // go straight to storage instead of through the loaded tree.
+    struct GenerationSession
+    {
+        std::string conversationId;
+        std::string parentId;
+        std::vector<std::unique_ptr<ReplyStream>> replies;
+    };
+    // Sessions with requests in flight, at most one per conversation
+    std::unordered_map<std::string, GenerationSession *> sessions;
+    std::mutex sessionMutex;
+
+    std::vector<ConversationTree::Handle> getContextPath(ConversationTree::Handle handle, size_t budget);
+    void loadContent(const std::vector<ConversationTree::Handle> &handles,
+                     std::unordered_map<std::string, std::string> fetched = {});
+    void forgetContent(ConversationTree::Handle handle);
+    void resetTree();
+    void loadTree(const std::string &conversationId);
+    ConversationTree::Handle addToTree(ConversationNode node, ConversationTree::Handle parent);
+    void markChanged(ConversationTree::Handle handle);
 
     void saveConversation();
 
+    std::vector<std::string> generateReplies(size_t count, AIBranchStreamCallback streamCallback);
+    void endSession(const GenerationSession &session);
+    void onStreamEvent(ReplyStream &reply, const SseEvent &event, const AIBranchStreamCallback &streamCallback);
+    void appendReply(ReplyStream &reply, const std::string &content, const AIBranchStreamCallback &streamCallback);
+    void applyReply(ReplyStream &reply);
+    void flushReply(ReplyStream &reply);
+    void finishReply(ReplyStream &reply, ConversationNode::STOP_REASON stopReason, bool cached = false);
+    void cancelReply(ReplyStream &reply);
+    std::chrono::milliseconds hedgeDelay(double percentile) const;
+
+    std::string fetchEndpoint(const std::string &endpoint, std::chrono::seconds ttl, bool refresh);
+    void storeEndpoint(const std::string &endpoint, CachedEndpoint entry);
+    void runRefreshes();
+
 public:
+    struct HedgeInfo
+    {
+        bool enabled;
+        double percentile;
+        // The delay the next reply would hedge after
+        size_t delayMs;
+    };
+
     AI();
+    AI(const AI &) = delete;
+    AI &operator=(const AI &) = delete;
+    ~AI();
 
     void addNode(ConversationNode::ROLE role, std::string content);
     bool deleteNode(const std::string &nodeId);
     bool switchNode(const std::string &nodeId);
 
     std::vector<std::string> getChildren(const std::string &nodeId);
-    std::vector<ConversationNode> getCurrentPath();
+    std::vector<ConversationNodeView> getCurrentPath();
     std::string getCurrentNodeId() const;
     std::string getRootNodeId() const;
     std::string getConversationId() const;
 
-    std::vector<ConversationInfo> getConversationList();
+    std::vector<ConversationInfo> getConversationList(long long afterUpdatedAt, const std::string &afterId, size_t limit);
     void createConversation(const std::string &title);
     void loadConversation(const std::string &conversationId);
     void deleteConversation(const std::string &conversationId);
     void updateConversationTitle(const std::string &conversationId, const std::string &title);
+    std::vector<SearchResult> searchConversations(const std::string &query, size_t limit);
+    std::string readNodeContent(const std::string &nodeId, size_t offset, size_t length,
+                                size_t &totalLength, size_t &nextOffset);
 
     void setSettings(const std::string &apiKey, const std::string &baseUrl,
                      const std::string &model, int maxTokens,
-                     double temperature, double topP, std::string systemPrompt);
+                     double temperature, double topP, std::string systemPrompt,
+                     int contextTokens);
     SettingsResponse getSettings() const;
 
+    // Generation runs in a session of the loaded conversation and carries on
+    // when another one is loaded; sessions of different conversations run
+    // side by side
     std::string generateResponse(AIStreamCallback streamCallback);
+    // Streams count sibling replies to the current node concurrently
+    std::vector<std::string> generateAlternatives(size_t count, AIBranchStreamCallback streamCallback);
+    // Stops the session of the loaded conversation
     void stopGeneration();
-    std::vector<std::string> getModels();
-    float getUserBalance();
+    bool stopGeneration(const std::string &conversationId);
+    bool stopAlternative(size_t branch);
+    // When on, a single reply that has not started to arrive by the hedge
+    // delay is requested a second time, and the first to answer is kept
+    void setHedging(bool enabled, double percentile);
+    HedgeInfo getHedging() const;
+
+    // Replies to requests made with temperature 0 are cached when enabled
+    void setResponseCache(bool enabled, size_t capacityBytes);
+    ResponseCache::Info getResponseCacheInfo() const;
+    void clearResponseCache();
+    // Served from the endpoint cache unless refresh is set; a stale answer is
+    // returned at once and refreshed in the background
+    std::vector<std::string> getModels(bool refresh = false);
+    float getUserBalance(bool refresh = false);
 };
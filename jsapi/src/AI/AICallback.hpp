@@ -20,4 +20,9 @@
 #include <string>
 #include <functional>
 
-using AIStreamCallback = std::function<void(const std::string &messageDelta)>;
+// Deltas name the conversation and node they belong to, since several
+// conversations may be generating at once
+using AIStreamCallback = std::function<void(const std::string &conversationId, const std::string &nodeId,
+                                            const std::string &messageDelta)>;
+using AIBranchStreamCallback = std::function<void(const std::string &conversationId, const std::string &nodeId,
+                                                  size_t branch, const std::string &messageDelta)>;
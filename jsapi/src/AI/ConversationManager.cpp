@@ -20,23 +20,37 @@
 #include <chrono>
 #include <algorithm>
 #include <stdexcept>
+#include <unordered_set>
 
-ConversationManager::ConversationManager() : database("/userdisk/database/langningchen-ai.db")
+ConversationManager::ConversationManager()
+    : database(DATABASE_DIR "langningchen-ai.db", DatabaseOptions(2)),
+      draftDatabase(DATABASE_DIR "langningchen-ai-drafts.db", DatabaseOptions::memory(1000, 250))
 {
     database.table("conversations")
         .column("id", TABLE::TEXT, TABLE::PRIMARY_KEY)
         .column("title", TABLE::TEXT, TABLE::NOT_NULL)
         .column("created_at", TABLE::INTEGER, TABLE::NOT_NULL)
         .column("updated_at", TABLE::INTEGER, TABLE::NOT_NULL)
+        .column("message_count", TABLE::INTEGER, TABLE::NOT_NULL | TABLE::DEFAULT, "-1")
+        .column("preview", TABLE::TEXT, TABLE::NOT_NULL | TABLE::DEFAULT, "")
+        .index({"updated_at", "id"})
         .execute();
     database.table("conversation_nodes")
         .column("id", TABLE::TEXT, TABLE::PRIMARY_KEY)
         .column("conversation_id", TABLE::TEXT, TABLE::NOT_NULL)
         .column("parent_id", TABLE::TEXT)
         .column("role", TABLE::INTEGER, TABLE::NOT_NULL)
-        .column("content", TABLE::TEXT, TABLE::NOT_NULL)
+        .column("content", TABLE::TEXT, TABLE::NOT_NULL | TABLE::COMPRESSED)
         .column("stop_reason", TABLE::INTEGER, TABLE::NOT_NULL)
         .column("created_at", TABLE::INTEGER, TABLE::NOT_NULL)
+        .column("content_length", TABLE::INTEGER, TABLE::NOT_NULL | TABLE::DEFAULT, "-1")
+        // Covers the skeleton query so opening a conversation never reads content pages
+        .index({"conversation_id", "parent_id", "role", "stop_reason", "content_length", "id"})
+        .execute();
+    draftDatabase.table("node_drafts")
+        .column("node_id", TABLE::TEXT, TABLE::PRIMARY_KEY)
+        .column("conversation_id", TABLE::TEXT, TABLE::NOT_NULL)
+        .column("data", TABLE::BLOB, TABLE::NOT_NULL)
         .execute();
     database.table("api_settings")
         .column("id", TABLE::TEXT, TABLE::PRIMARY_KEY)
@@ -47,26 +61,108 @@ ConversationManager::ConversationManager() : database("/userdisk/database/langni
         .column("temperature", TABLE::REAL, TABLE::NOT_NULL)
         .column("top_p", TABLE::REAL, TABLE::NOT_NULL)
         .column("system_prompt", TABLE::TEXT, TABLE::NOT_NULL)
+        .column("context_tokens", TABLE::INTEGER, TABLE::NOT_NULL | TABLE::DEFAULT, "65536")
+        .execute();
+    database.table("api_cache")
+        .column("endpoint", TABLE::TEXT, TABLE::PRIMARY_KEY)
+        .column("credentials", TABLE::TEXT, TABLE::NOT_NULL)
+        .column("body", TABLE::TEXT, TABLE::NOT_NULL)
+        .column("fetched_at", TABLE::INTEGER, TABLE::NOT_NULL)
+        .execute();
+    database.table("hedge_settings")
+        .column("id", TABLE::TEXT, TABLE::PRIMARY_KEY)
+        .column("enabled", TABLE::INTEGER, TABLE::NOT_NULL)
+        .column("percentile", TABLE::REAL, TABLE::NOT_NULL)
+        .execute();
+    // content is stored compressed; SQL that needs the text goes through this view
+    database.query("CREATE VIEW IF NOT EXISTS conversation_nodes_text AS "
+                   "SELECT rowid AS node_rowid, decompress(content) AS content, conversation_id, role "
+                   "FROM conversation_nodes")
+        .execute();
+    createSearchIndex();
+
+    // Conversations saved before summaries existed are summarised once here
+    database.query("UPDATE conversations SET "
+                   "message_count = (SELECT COUNT(*) FROM conversation_nodes "
+                   "WHERE conversation_id = conversations.id AND role != ?2), "
+                   "preview = COALESCE((SELECT substr(decompress(content), 1, ?1) FROM conversation_nodes "
+                   "WHERE conversation_id = conversations.id AND role != ?2 ORDER BY rowid DESC LIMIT 1), '') "
+                   "WHERE message_count < 0")
+        .bind(PREVIEW_LENGTH)
+        .bind((int)ConversationNode::ROLE_SYSTEM)
+        .execute();
+    // Likewise for the byte lengths the skeleton reports
+    database.query("UPDATE conversation_nodes SET content_length = length(CAST(decompress(content) AS BLOB)) "
+                   "WHERE content_length < 0")
         .execute();
 }
 
-std::vector<ConversationInfo> ConversationManager::getConversationList()
+void ConversationManager::createSearchIndex()
+{
+    // The index mirrors conversation_nodes through triggers, so every save path keeps it current.
+    // It is an external-content table over conversation_nodes_text, since content is stored
+    // compressed. Trigram tokens let Chinese text match any substring of three or more characters.
+    try
+    {
+        TRANSACTION transaction = database.transaction();
+        bool exists = !database.query("SELECT name FROM sqlite_master WHERE name = ?")
+                           .bind("conversation_text_fts")
+                           .execute()
+                           .empty();
+        database.query("CREATE VIRTUAL TABLE IF NOT EXISTS conversation_text_fts USING fts5("
+                       "content, conversation_id UNINDEXED, role UNINDEXED, "
+                       "content='conversation_nodes_text', content_rowid='node_rowid', tokenize='trigram')")
+            .execute();
+        database.query("CREATE TRIGGER IF NOT EXISTS conversation_text_fts_insert AFTER INSERT ON conversation_nodes BEGIN "
+                       "INSERT INTO conversation_text_fts(rowid, content, conversation_id, role) "
+                       "VALUES (new.rowid, decompress(new.content), new.conversation_id, new.role); END")
+            .execute();
+        database.query("CREATE TRIGGER IF NOT EXISTS conversation_text_fts_delete AFTER DELETE ON conversation_nodes BEGIN "
+                       "INSERT INTO conversation_text_fts(conversation_text_fts, rowid, content, conversation_id, role) "
+                       "VALUES ('delete', old.rowid, decompress(old.content), old.conversation_id, old.role); END")
+            .execute();
+        database.query("CREATE TRIGGER IF NOT EXISTS conversation_text_fts_update AFTER UPDATE ON conversation_nodes BEGIN "
+                       "INSERT INTO conversation_text_fts(conversation_text_fts, rowid, content, conversation_id, role) "
+                       "VALUES ('delete', old.rowid, decompress(old.content), old.conversation_id, old.role); "
+                       "INSERT INTO conversation_text_fts(rowid, content, conversation_id, role) "
+                       "VALUES (new.rowid, decompress(new.content), new.conversation_id, new.role); END")
+            .execute();
+        if (!exists)
+            database.query("INSERT INTO conversation_text_fts(conversation_text_fts) VALUES ('rebuild')").execute();
+        transaction.commit();
+        fullTextSearch = true;
+    }
+    catch (const std::exception &)
+    {
+        // SQLite without FTS5 or the trigram tokenizer: searchConversations falls back to a scan
+        fullTextSearch = false;
+    }
+}
+
+std::vector<ConversationInfo> ConversationManager::getConversationList(long long afterUpdatedAt, const std::string &afterId,
+                                                                       size_t limit)
 {
-    std::lock_guard<std::mutex> lock(dbMutex);
     std::vector<ConversationInfo> conversations;
-    auto results = database.select("conversations")
-                       .select("id")
-                       .select("title")
-                       .select("created_at")
-                       .select("updated_at")
-                       .order("updated_at", false)
-                       .execute();
-    for (const auto &row : results)
-        conversations.push_back(ConversationInfo(
-            row.at("id"),
-            row.at("title"),
-            std::stoll(row.at("created_at")),
-            std::stoll(row.at("updated_at"))));
+    conversations.reserve(limit);
+    database.query("SELECT id, title, created_at, updated_at, message_count, preview FROM conversations "
+                   "WHERE updated_at < ? OR (updated_at = ? AND id < ?) "
+                   "ORDER BY updated_at DESC, id DESC LIMIT ?")
+        .bind(afterUpdatedAt)
+        .bind(afterUpdatedAt)
+        .bind(afterId)
+        .bind(limit)
+        .forEach(
+            [&conversations](const std::unordered_map<std::string, std::string> &row)
+            {
+                conversations.push_back(ConversationInfo(
+                    row.at("id"),
+                    row.at("title"),
+                    std::stoll(row.at("created_at")),
+                    std::stoll(row.at("updated_at")),
+                    std::stoi(row.at("message_count")),
+                    row.at("preview")));
+                return true;
+            });
     return conversations;
 }
 
@@ -82,17 +178,23 @@ void ConversationManager::createConversation(const std::string &title, std::stri
         .value("title", title)
         .value("created_at", currentTime)
         .value("updated_at", currentTime)
+        .value("message_count", 0)
         .execute();
 }
 void ConversationManager::deleteConversation(const std::string &conversationId)
 {
     std::lock_guard<std::mutex> lock(dbMutex);
+    TRANSACTION transaction = database.transaction();
     database.remove("conversation_nodes")
         .where("conversation_id", conversationId)
         .execute();
     database.remove("conversations")
         .where("id", conversationId)
         .execute();
+    transaction.commit();
+    draftDatabase.remove("node_drafts")
+        .where("conversation_id", conversationId)
+        .execute();
 }
 void ConversationManager::updateConversationTitle(const std::string &conversationId, const std::string &title)
 {
@@ -103,85 +205,348 @@ void ConversationManager::updateConversationTitle(const std::string &conversatio
         .execute();
 }
 
-void ConversationManager::saveConversation(const std::string &conversationId,
-                                           const std::unordered_map<std::string, std::unique_ptr<ConversationNode>> &nodeMap)
+std::vector<SearchResult> ConversationManager::searchConversations(const std::string &query, size_t limit)
+{
+    std::vector<SearchResult> results;
+    if (query.empty() || limit == 0)
+        return results;
+    std::unordered_set<std::string> seen;
+    auto collect = [&results, &seen, limit](const std::unordered_map<std::string, std::string> &row)
+    {
+        if (seen.insert(row.at("conversation_id")).second)
+            results.push_back(SearchResult(row.at("conversation_id"), row.at("title"), row.at("snippet"),
+                                           std::stoll(row.at("updated_at"))));
+        return results.size() < limit;
+    };
+
+    database.query("SELECT id AS conversation_id, title, updated_at, '' AS snippet FROM conversations "
+                   "WHERE instr(title, ?) > 0 ORDER BY updated_at DESC")
+        .bind(query)
+        .forEach(collect);
+    if (results.size() >= limit)
+        return results;
+
+    if (fullTextSearch && strUtils::utf8Length(query) >= 3)
+    {
+        std::string phrase = "\"";
+        for (char ch : query)
+            phrase += ch == '"' ? std::string("\"\"") : std::string(1, ch);
+        phrase += "\"";
+        database.query("SELECT conversation_text_fts.conversation_id AS conversation_id, conversations.title AS title, "
+                       "conversations.updated_at AS updated_at, snippet(conversation_text_fts, 0, '', '', '…', 16) AS snippet "
+                       "FROM conversation_text_fts JOIN conversations ON conversations.id = conversation_text_fts.conversation_id "
+                       "WHERE conversation_text_fts MATCH ? AND conversation_text_fts.role != ? ORDER BY rank")
+            .bind(phrase)
+            .bind((int)ConversationNode::ROLE_SYSTEM)
+            .forEach(collect);
+    }
+    else
+        database.query("SELECT conversation_nodes_text.conversation_id AS conversation_id, conversations.title AS title, "
+                       "conversations.updated_at AS updated_at, substr(conversation_nodes_text.content, max(1, instr(conversation_nodes_text.content, ?1) - 8), 32) AS snippet "
+                       "FROM conversation_nodes_text JOIN conversations ON conversations.id = conversation_nodes_text.conversation_id "
+                       "WHERE instr(conversation_nodes_text.content, ?1) > 0 AND conversation_nodes_text.role != ?2 "
+                       "ORDER BY conversations.updated_at DESC")
+            .bind(query)
+            .bind((int)ConversationNode::ROLE_SYSTEM)
+            .forEach(collect);
+    return results;
+}
+
+void ConversationManager::saveConversation(const std::string &conversationId, const ConversationChanges &changes)
 {
     std::lock_guard<std::mutex> lock(dbMutex);
     auto currentTime = std::chrono::duration_cast<std::chrono::seconds>(
                            std::chrono::system_clock::now().time_since_epoch())
                            .count();
 
+    TRANSACTION transaction = database.transaction();
     database.update("conversations")
         .set("updated_at", currentTime)
+        .set("message_count", changes.messageCount)
+        .set("preview", changes.preview)
         .where("id", conversationId)
         .execute();
 
-    database.remove("conversation_nodes")
-        .where("conversation_id", conversationId)
-        .execute();
+    for (const auto &nodeId : changes.deleted)
+        database.remove("conversation_nodes")
+            .where("id", nodeId)
+            .execute();
 
-    for (const auto &pair : nodeMap)
+    for (const auto &node : changes.inserted)
+        database.insert("conversation_nodes")
+            .value("id", node.id)
+            .value("conversation_id", conversationId)
+            .value("parent_id", node.parentId)
+            .value("role", (int)node.role)
+            .value("content", *node.content)
+            .value("content_length", node.content->size())
+            .value("stop_reason", (int)node.stopReason)
+            .value("created_at", currentTime)
+            .execute();
+
+    for (const auto &node : changes.updated)
     {
-        const auto &node = pair.second;
-        if (!node)
-            continue;
+        ASSERT(node.contentLoaded);
+        database.update("conversation_nodes")
+            .set("parent_id", node.parentId)
+            .set("content", *node.content)
+            .set("content_length", node.content->size())
+            .set("stop_reason", (int)node.stopReason)
+            .where("id", node.id)
+            .execute();
+    }
+    transaction.commit();
+}
+bool ConversationManager::saveNode(const std::string &conversationId, const ConversationChanges::Node &node)
+{
+    ASSERT(node.contentLoaded);
+    std::lock_guard<std::mutex> lock(dbMutex);
+    auto currentTime = std::chrono::duration_cast<std::chrono::seconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
 
+    TRANSACTION transaction = database.transaction();
+    if (database.query("SELECT id FROM conversations WHERE id = ?")
+            .bind(conversationId)
+            .execute()
+            .empty())
+        return false;
+    bool stored = !database.query("SELECT id FROM conversation_nodes WHERE id = ?")
+                       .bind(node.id)
+                       .execute()
+                       .empty();
+    if (stored)
+        database.update("conversation_nodes")
+            .set("content", *node.content)
+            .set("content_length", node.content->size())
+            .set("stop_reason", (int)node.stopReason)
+            .where("id", node.id)
+            .execute();
+    else
+    {
+        if (database.query("SELECT id FROM conversation_nodes WHERE id = ? AND conversation_id = ?")
+                .bind(node.parentId)
+                .bind(conversationId)
+                .execute()
+                .empty())
+            return false;
         database.insert("conversation_nodes")
-            .value("id", node->id)
+            .value("id", node.id)
             .value("conversation_id", conversationId)
-            .value("parent_id", node->parentId)
-            .value("role", (int)node->role)
-            .value("content", node->content)
-            .value("stop_reason", (int)node->stopReason)
+            .value("parent_id", node.parentId)
+            .value("role", (int)node.role)
+            .value("content", *node.content)
+            .value("content_length", node.content->size())
+            .value("stop_reason", (int)node.stopReason)
             .value("created_at", currentTime)
             .execute();
     }
+    // The summary is worked out from storage, the same way as for conversations
+    // saved before summaries existed
+    database.query("UPDATE conversations SET updated_at = ?1, "
+                   "message_count = (SELECT COUNT(*) FROM conversation_nodes "
+                   "WHERE conversation_id = conversations.id AND role != ?4), "
+                   "preview = COALESCE((SELECT substr(decompress(content), 1, ?2) FROM conversation_nodes "
+                   "WHERE conversation_id = conversations.id AND role != ?4 ORDER BY rowid DESC LIMIT 1), '') "
+                   "WHERE id = ?3")
+        .bind(currentTime)
+        .bind(PREVIEW_LENGTH)
+        .bind(conversationId)
+        .bind((int)ConversationNode::ROLE_SYSTEM)
+        .execute();
+    transaction.commit();
+    return true;
 }
-void ConversationManager::loadConversation(const std::string &conversationId,
-                                           std::unordered_map<std::string, std::unique_ptr<ConversationNode>> &nodeMap,
-                                           std::string &rootNodeId, std::string &leafNodeId)
+void ConversationManager::loadConversation(const std::string &conversationId, ConversationTree &tree,
+                                           ConversationTree::Handle &rootNode, ConversationTree::Handle &leafNode)
 {
-    std::lock_guard<std::mutex> lock(dbMutex);
-    nodeMap.clear();
-    rootNodeId.clear();
+    tree.clear();
+    rootNode = ConversationTree::NONE;
+
+    // Only the skeleton is read here; content is fetched on demand with loadNodeContents.
+    // Parents are linked in a second pass since a row may name a parent stored after it
+    std::vector<std::pair<ConversationTree::Handle, std::string>> parentIds;
+    database.query("SELECT id, parent_id, role, stop_reason, content_length FROM conversation_nodes "
+                   "WHERE conversation_id = ? ORDER BY rowid")
+        .bind(conversationId)
+        .forEach([&](const std::unordered_map<std::string, std::string> &row)
+                 {
+                     const std::string &nodeId = row.at("id");
+                     const std::string &parentId = row.at("parent_id");
+                     int role = std::stoi(row.at("role"));
+                     int stopReason = std::stoi(row.at("stop_reason"));
+
+                     ConversationNode node(nodeId, static_cast<ConversationNode::ROLE>(role), "",
+                                           static_cast<ConversationNode::STOP_REASON>(stopReason));
+                     node.isNew = false;
+                     node.contentLoaded = false;
+                     node.contentLength = std::stoull(row.at("content_length"));
+                     ConversationTree::Handle handle = tree.add(std::move(node), ConversationTree::NONE);
+
+                     if (!parentId.empty())
+                         parentIds.emplace_back(handle, parentId);
+                     else
+                         rootNode = handle;
+                     return true; });
 
-    auto nodeResults = database.select("conversation_nodes")
-                           .where("conversation_id", conversationId)
-                           .execute();
+    for (const auto &pair : parentIds)
+    {
+        ConversationTree::Handle parent = tree.find(pair.second);
+        if (parent != ConversationTree::NONE)
+            tree.attach(pair.first, parent);
+    }
 
-    std::unordered_map<std::string, std::vector<std::string>> parentToChildren;
+    recoverDrafts(conversationId, tree);
+
+    leafNode = tree.lastLeaf(rootNode);
+}
 
-    for (const auto &row : nodeResults)
+void ConversationManager::beginDraft(const std::string &conversationId, const std::string &nodeId, const std::string &content)
+{
+    std::lock_guard<std::mutex> lock(dbMutex);
+    size_t capacity = DRAFT_INITIAL_CAPACITY;
+    while (capacity < content.size())
+        capacity *= 2;
+    draftDatabase.query("INSERT OR REPLACE INTO node_drafts (node_id, conversation_id, data) VALUES (?, ?, zeroblob(?))")
+        .bind(nodeId)
+        .bind(conversationId)
+        .bind(capacity)
+        .execute();
+    auto rows = draftDatabase.query("SELECT rowid FROM node_drafts WHERE node_id = ?")
+                    .bind(nodeId)
+                    .execute();
+    ASSERT(!rows.empty());
+    Draft draft{std::stoll(rows[0].at("rowid")), 0, capacity};
+    if (!content.empty())
+        draftDatabase.blob("node_drafts", "data", draft.rowId, true).write(0, content);
+    draft.length = content.size();
+    drafts[nodeId] = draft;
+}
+void ConversationManager::appendDraft(const std::string &nodeId, const std::string &delta)
+{
+    std::lock_guard<std::mutex> lock(dbMutex);
+    auto it = drafts.find(nodeId);
+    if (it == drafts.end() || delta.empty())
+        return;
+    Draft &draft = it->second;
+    if (draft.length + delta.size() > draft.capacity)
+        growDraft(draft, draft.length + delta.size());
+    draftDatabase.blob("node_drafts", "data", draft.rowId, true).write(draft.length, delta);
+    draft.length += delta.size();
+}
+void ConversationManager::growDraft(Draft &draft, size_t required)
+{
+    size_t capacity = draft.capacity;
+    while (capacity < required)
+        capacity *= 2;
+    std::string written = draftDatabase.blob("node_drafts", "data", draft.rowId, true).read(0, draft.length);
+    TRANSACTION transaction = draftDatabase.transaction();
+    draftDatabase.query("UPDATE node_drafts SET data = zeroblob(?) WHERE rowid = ?")
+        .bind(capacity)
+        .bind(draft.rowId)
+        .execute();
+    draftDatabase.blob("node_drafts", "data", draft.rowId, true).write(0, written);
+    transaction.commit();
+    draft.capacity = capacity;
+}
+void ConversationManager::discardDraft(const std::string &nodeId)
+{
+    std::lock_guard<std::mutex> lock(dbMutex);
+    if (drafts.erase(nodeId) == 0)
+        return;
+    draftDatabase.remove("node_drafts")
+        .where("node_id", nodeId)
+        .execute();
+}
+void ConversationManager::recoverDrafts(const std::string &conversationId, ConversationTree &tree)
+{
+    // Drafts left behind by a crash or a failed request hold the most complete
+    // copy of their reply; fold them back into the node and drop them
+    std::lock_guard<std::mutex> lock(dbMutex);
+    auto draftRows = draftDatabase.query("SELECT node_id, data FROM node_drafts WHERE conversation_id = ?")
+                         .bind(conversationId)
+                         .execute();
+    if (draftRows.empty())
+        return;
+    std::vector<std::string> recovered;
+    TRANSACTION transaction = database.transaction();
+    for (const auto &row : draftRows)
     {
-        std::string nodeId = row.at("id");
-        std::string parentId = row.at("parent_id");
-        int role = std::stoi(row.at("role"));
-        std::string content = row.at("content");
-        int stopReason = row.count("stop_reason") ? std::stoi(row.at("stop_reason")) : 6; // Default to STOP_REASON_NONE
-
-        nodeMap[nodeId] = std::make_unique<ConversationNode>(
-            nodeId, static_cast<ConversationNode::ROLE>(role), content, parentId, static_cast<ConversationNode::STOP_REASON>(stopReason));
-
-        if (!parentId.empty())
-            parentToChildren[parentId].push_back(nodeId);
-        else
-            rootNodeId = nodeId;
+        const std::string &nodeId = row.at("node_id");
+        if (drafts.count(nodeId))
+            continue;
+        std::string content = row.at("data");
+        content.resize(std::min(content.find('\0'), content.size()));
+        ConversationTree::Handle handle = tree.find(nodeId);
+        if (handle != ConversationTree::NONE && content.size() > tree[handle].contentLength)
+        {
+            ConversationNode &node = tree[handle];
+            node.content = ConversationNode::makeContent(content);
+            node.contentLoaded = true;
+            node.contentLength = content.size();
+            if (node.stopReason == ConversationNode::STOP_REASON_NONE)
+                node.stopReason = ConversationNode::STOP_REASON_ERROR;
+            database.update("conversation_nodes")
+                .set("content", content)
+                .set("content_length", content.size())
+                .set("stop_reason", (int)node.stopReason)
+                .where("id", nodeId)
+                .execute();
+        }
+        recovered.push_back(nodeId);
     }
+    transaction.commit();
+    for (const auto &nodeId : recovered)
+        draftDatabase.remove("node_drafts")
+            .where("node_id", nodeId)
+            .execute();
+}
 
-    for (const auto &pair : parentToChildren)
-        if (nodeMap.find(pair.first) != nodeMap.end())
-            nodeMap[pair.first]->childIds = pair.second;
+std::unordered_map<std::string, std::string> ConversationManager::loadNodeContents(const std::vector<std::string> &nodeIds)
+{
+    std::unordered_map<std::string, std::string> contents;
+    for (size_t begin = 0; begin < nodeIds.size(); begin += CONTENT_BATCH_SIZE)
+    {
+        size_t end = std::min(nodeIds.size(), begin + CONTENT_BATCH_SIZE);
+        std::string placeholders;
+        for (size_t i = begin; i < end; i++)
+            placeholders += i == begin ? "?" : ", ?";
+        QUERY query = database.query("SELECT id, decompress(content) AS content FROM conversation_nodes WHERE id IN (" + placeholders + ")");
+        for (size_t i = begin; i < end; i++)
+            (void)query.bind(nodeIds[i]);
+        query.forEach([&](const std::unordered_map<std::string, std::string> &row)
+                      {
+                          contents[row.at("id")] = row.at("content");
+                          return true; });
+    }
+    return contents;
+}
 
-    leafNodeId = rootNodeId;
-    while (!nodeMap[leafNodeId]->childIds.empty())
-        leafNodeId = nodeMap[leafNodeId]->childIds.back();
+std::string ConversationManager::readNodeContent(const std::string &nodeId, size_t offset, size_t length,
+                                                 size_t &totalLength, size_t &nextOffset)
+{
+    auto rows = database.query("SELECT rowid FROM conversation_nodes WHERE id = ?")
+                    .bind(nodeId)
+                    .execute();
+    ASSERT(!rows.empty());
+    BLOB content = database.blob("conversation_nodes", "content", std::stoll(rows[0].at("rowid")));
+    std::string range = ColumnCodec::decodeRange(content, offset, length, totalLength);
+    // An offset inside a character starts at the next one
+    size_t skipped = 0;
+    while (skipped < range.size() && skipped < 3 && (static_cast<unsigned char>(range[skipped]) & 0xC0) == 0x80)
+        skipped++;
+    std::string text = strUtils::utf8TrimPartial(range.substr(skipped));
+    nextOffset = offset + skipped + text.size();
+    return text;
 }
 
 void ConversationManager::saveApiSettings(const std::string &apiKey, const std::string &baseUrl,
                                           const std::string &model, int maxTokens,
-                                          double temperature, double topP, const std::string &systemPrompt)
+                                          double temperature, double topP, const std::string &systemPrompt,
+                                          int contextTokens)
 {
     std::lock_guard<std::mutex> lock(dbMutex);
+    TRANSACTION transaction = database.transaction();
     database.remove("api_settings").execute();
     database.insert("api_settings")
         .value("id", "default")
@@ -192,14 +557,16 @@ void ConversationManager::saveApiSettings(const std::string &apiKey, const std::
         .value("temperature", temperature)
         .value("top_p", topP)
         .value("system_prompt", systemPrompt)
+        .value("context_tokens", contextTokens)
         .execute();
+    transaction.commit();
 }
 
 void ConversationManager::loadApiSettings(std::string &apiKey, std::string &baseUrl,
                                           std::string &model, int &maxTokens,
-                                          double &temperature, double &topP, std::string &systemPrompt)
+                                          double &temperature, double &topP, std::string &systemPrompt,
+                                          int &contextTokens)
 {
-    std::lock_guard<std::mutex> lock(dbMutex);
     auto results = database.select("api_settings")
                        .where("id", "default")
                        .execute();
@@ -214,5 +581,63 @@ void ConversationManager::loadApiSettings(std::string &apiKey, std::string &base
         temperature = std::stod(row.at("temperature"));
         topP = std::stod(row.at("top_p"));
         systemPrompt = row.at("system_prompt");
+        contextTokens = std::stoi(row.at("context_tokens"));
     }
 }
+
+void ConversationManager::saveHedgeSettings(bool enabled, double percentile)
+{
+    std::lock_guard<std::mutex> lock(dbMutex);
+    TRANSACTION transaction = database.transaction();
+    database.remove("hedge_settings").execute();
+    database.insert("hedge_settings")
+        .value("id", "default")
+        .value("enabled", enabled ? 1 : 0)
+        .value("percentile", percentile)
+        .execute();
+    transaction.commit();
+}
+
+void ConversationManager::loadHedgeSettings(bool &enabled, double &percentile)
+{
+    auto results = database.select("hedge_settings")
+                       .where("id", "default")
+                       .execute();
+
+    if (!results.empty())
+    {
+        enabled = std::stoi(results[0].at("enabled")) != 0;
+        percentile = std::stod(results[0].at("percentile"));
+    }
+}
+
+std::unordered_map<std::string, CachedEndpoint> ConversationManager::loadApiCache()
+{
+    std::unordered_map<std::string, CachedEndpoint> entries;
+    for (const auto &row : database.select("api_cache").execute())
+        entries.emplace(row.at("endpoint"),
+                        CachedEndpoint(row.at("credentials"), row.at("body"), std::stoll(row.at("fetched_at"))));
+    return entries;
+}
+
+void ConversationManager::saveApiCache(const std::string &endpoint, const CachedEndpoint &entry)
+{
+    std::lock_guard<std::mutex> lock(dbMutex);
+    TRANSACTION transaction = database.transaction();
+    database.remove("api_cache")
+        .where("endpoint", endpoint)
+        .execute();
+    database.insert("api_cache")
+        .value("endpoint", endpoint)
+        .value("credentials", entry.credentials)
+        .value("body", entry.body)
+        .value("fetched_at", entry.fetchedAt)
+        .execute();
+    transaction.commit();
+}
+
+void ConversationManager::clearApiCache()
+{
+    std::lock_guard<std::mutex> lock(dbMutex);
+    database.remove("api_cache").execute();
+}
@@ -22,35 +22,92 @@
 #include <memory>
 #include <unordered_map>
 #include <mutex>
+#include <climits>
 #include "Database/Database.hpp"
-#include "ConversationNode.hpp"
+#include "ConversationTree.hpp"
 #include "ConversationInfo.hpp"
+#include "SearchResult.hpp"
+#include "ConversationChanges.hpp"
+#include "CachedEndpoint.hpp"
 
 class ConversationManager
 {
 private:
     DATABASE database;
+    // Streaming drafts are rewritten many times a second and only matter after a crash,
+    // so they live in memory and are snapshotted to their own file
+    DATABASE draftDatabase;
+    // Serialises writers only; reads go through the database's WAL reader pool
     mutable std::mutex dbMutex;
+    bool fullTextSearch = false;
+
+    // A reply being streamed lives in a zero-padded node_drafts blob; deltas are
+    // written in place and the blob doubles when full, so each append costs its own bytes
+    struct Draft
+    {
+        sqlite3_int64 rowId;
+        size_t length;
+        size_t capacity;
+    };
+    std::unordered_map<std::string, Draft> drafts;
+    static constexpr size_t DRAFT_INITIAL_CAPACITY = 4096;
+    // Ids bound per query by loadNodeContents
+    static constexpr size_t CONTENT_BATCH_SIZE = 256;
+
+    void createSearchIndex();
+    void growDraft(Draft &draft, size_t required);
+    void recoverDrafts(const std::string &conversationId, ConversationTree &tree);
 
 public:
+    static constexpr size_t PREVIEW_LENGTH = 60;
+
     ConversationManager();
     ~ConversationManager() = default;
 
-    std::vector<ConversationInfo> getConversationList();
+    // Keyset pagination: returns up to limit conversations ordered after (afterUpdatedAt, afterId)
+    std::vector<ConversationInfo> getConversationList(long long afterUpdatedAt = LLONG_MAX, const std::string &afterId = "",
+                                                      size_t limit = 20);
     void createConversation(const std::string &title, std::string &outConversationId);
     void deleteConversation(const std::string &conversationId);
     void updateConversationTitle(const std::string &conversationId, const std::string &title);
+    std::vector<SearchResult> searchConversations(const std::string &query, size_t limit);
 
-    void saveConversation(const std::string &conversationId,
-                          const std::unordered_map<std::string, std::unique_ptr<ConversationNode>> &nodeMap);
-    void loadConversation(const std::string &conversationId,
-                          std::unordered_map<std::string, std::unique_ptr<ConversationNode>> &nodeMap,
-                          std::string &rootNodeId, std::string &leafNodeId);
+    // Writes only the changed nodes, in one transaction
+    void saveConversation(const std::string &conversationId, const ConversationChanges &changes);
+    // Loads the tree without message bodies; nodes come back with contentLoaded false
+    void loadConversation(const std::string &conversationId, ConversationTree &tree,
+                          ConversationTree::Handle &rootNode, ConversationTree::Handle &leafNode);
+
+    // Writes one node straight to storage, together with the conversation's
+    // summary, for a reply whose conversation is not the loaded one. Returns
+    // false when the conversation or, for a new node, its parent is gone.
+    bool saveNode(const std::string &conversationId, const ConversationChanges::Node &node);
+
+    void beginDraft(const std::string &conversationId, const std::string &nodeId, const std::string &content);
+    void appendDraft(const std::string &nodeId, const std::string &delta);
+    // Called once the node itself has been saved with its final content
+    void discardDraft(const std::string &nodeId);
+    // Bodies of stored nodes, keyed by id; ids that are not stored are left out
+    std::unordered_map<std::string, std::string> loadNodeContents(const std::vector<std::string> &nodeIds);
+    // Reads a byte range of a stored node without loading the whole content.
+    // The result never starts or ends inside a UTF-8 sequence; nextOffset is
+    // where the following read continues.
+    std::string readNodeContent(const std::string &nodeId, size_t offset, size_t length,
+                                size_t &totalLength, size_t &nextOffset);
 
     void saveApiSettings(const std::string &apiKey, const std::string &baseUrl,
                          const std::string &model, int maxTokens,
-                         double temperature, double topP, const std::string &systemPrompt);
+                         double temperature, double topP, const std::string &systemPrompt,
+                         int contextTokens);
     void loadApiSettings(std::string &apiKey, std::string &baseUrl,
                          std::string &model, int &maxTokens,
-                         double &temperature, double &topP, std::string &systemPrompt);
+                         double &temperature, double &topP, std::string &systemPrompt,
+                         int &contextTokens);
+    void saveHedgeSettings(bool enabled, double percentile);
+    void loadHedgeSettings(bool &enabled, double &percentile);
+
+    // Responses of account endpoints, keyed by endpoint path
+    std::unordered_map<std::string, CachedEndpoint> loadApiCache();
+    void saveApiCache(const std::string &endpoint, const CachedEndpoint &entry);
+    void clearApiCache();
 };
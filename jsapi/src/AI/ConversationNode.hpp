@@ -17,12 +17,21 @@
 
 #pragma once
 
+#include "strUtils.hpp"
 #include <string>
 #include <nlohmann/json.hpp>
 #include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 struct ConversationNode
 {
+    // Index of a node in its ConversationTree; only valid while the node exists
+    using Handle = uint32_t;
+    static constexpr Handle NONE = UINT32_MAX;
+
+    // External key, as stored and as seen by JS
     std::string id;
     enum ROLE
     {
@@ -42,16 +51,96 @@ struct ConversationNode
         STOP_REASON_NONE = 6
     } stopReason;
 
-    std::string content;
-    std::string parentId;
-    std::vector<std::string> childIds;
+    // Shared with the views handed out and never changed while they hold it;
+    // changing the text replaces it, except that a streaming reply appends in
+    // place to a buffer nothing else references (AI::applyReply)
+    std::shared_ptr<const std::string> content;
+    Handle parent = NONE;
+    std::vector<Handle> children;
     int64_t timestamp;
+    // Persistence state: isNew until first saved, dirty when content, stopReason or parent changed since
+    bool isNew = true;
+    bool dirty = false;
+    // Stored nodes are loaded without content; contentLength is its size in bytes until it is fetched
+    bool contentLoaded = true;
+    size_t contentLength = 0;
+    // Cached strUtils::estimateTokens of content, redone when its length changes
+    size_t tokenEstimate = 0;
+    size_t tokenEstimateLength = SIZE_MAX;
+    // Cached request message {"role":…,"content":…}, rebuilt when content is replaced;
+    // messageJsonSource is the content it was built from
+    std::string messageJson;
+    std::shared_ptr<const std::string> messageJsonSource;
 
-    ConversationNode(std::string id, ROLE role, std::string content, std::string parentId, STOP_REASON stopReason = STOP_REASON_NONE)
-        : id(id), role(role), stopReason(stopReason), content(content), parentId(parentId),
+    ConversationNode(std::string id, ROLE role, std::string content, STOP_REASON stopReason = STOP_REASON_NONE)
+        : id(id), role(role), stopReason(stopReason), content(makeContent(std::move(content))),
           timestamp(std::chrono::duration_cast<std::chrono::milliseconds>(
                         std::chrono::system_clock::now().time_since_epoch())
                         .count())
     {
     }
+
+    static std::shared_ptr<const std::string> makeContent(std::string text)
+    {
+        static const std::shared_ptr<const std::string> empty = std::make_shared<const std::string>();
+        return text.empty() ? empty : std::make_shared<const std::string>(std::move(text));
+    }
+
+    size_t tokenCount()
+    {
+        // Until the text itself is at hand, a third of its byte length: what
+        // estimateTokens gives for CJK text and a little over it for ASCII
+        if (!contentLoaded)
+            return (contentLength + 2) / 3;
+        if (tokenEstimateLength != content->size())
+        {
+            tokenEstimate = strUtils::estimateTokens(*content);
+            tokenEstimateLength = content->size();
+        }
+        return tokenEstimate;
+    }
+
+    const std::string &messageFragment()
+    {
+        if (messageJsonSource != content)
+        {
+            static const char *const roleNames[] = {"user", "assistant", "system"};
+            // Invalid UTF-8 is replaced rather than failing every later request of the conversation
+            std::string escaped = nlohmann::json(*content).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+            messageJson.clear();
+            messageJson.reserve(escaped.size() + 40);
+            messageJson += "{\"role\":\"";
+            messageJson += roleNames[role];
+            messageJson += "\",\"content\":";
+            messageJson += escaped;
+            messageJson += '}';
+            messageJsonSource = content;
+        }
+        return messageJson;
+    }
+    void dropContent()
+    {
+        contentLength = content->size();
+        content = makeContent("");
+        contentLoaded = false;
+        messageJson = std::string();
+        messageJsonSource.reset();
+    }
+};
+
+// What path queries hand out: a copy of the node's small fields that shares
+// its content buffer, so it stays valid after the state lock is released
+struct ConversationNodeView
+{
+    std::string id;
+    ConversationNode::ROLE role;
+    ConversationNode::STOP_REASON stopReason;
+    std::shared_ptr<const std::string> content;
+    std::string parentId;
+    std::vector<std::string> childIds;
+    int64_t timestamp;
+
+    ConversationNodeView(const ConversationNode &node, std::string parentId, std::vector<std::string> childIds)
+        : id(node.id), role(node.role), stopReason(node.stopReason), content(node.content),
+          parentId(std::move(parentId)), childIds(std::move(childIds)), timestamp(node.timestamp) {}
 };
@@ -0,0 +1,83 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "ConversationTree.hpp"
+#include <algorithm>
+
+ConversationTree::Handle ConversationTree::add(ConversationNode node, Handle parent)
+{
+    Handle handle;
+    if (!freeSlots.empty())
+    {
+        handle = freeSlots.back();
+        freeSlots.pop_back();
+        nodes[handle] = std::move(node);
+    }
+    else
+    {
+        handle = nodes.size();
+        nodes.push_back(std::move(node));
+    }
+    handles[nodes[handle].id] = handle;
+    nodes[handle].parent = NONE;
+    nodes[handle].children.clear();
+    if (parent != NONE)
+        attach(handle, parent);
+    return handle;
+}
+void ConversationTree::attach(Handle handle, Handle parent)
+{
+    nodes[handle].parent = parent;
+    nodes[parent].children.push_back(handle);
+}
+void ConversationTree::clear()
+{
+    nodes.clear();
+    freeSlots.clear();
+    handles.clear();
+}
+
+ConversationTree::Handle ConversationTree::find(const std::string &id) const
+{
+    auto it = handles.find(id);
+    return it != handles.end() ? it->second : NONE;
+}
+
+std::vector<ConversationTree::Handle> ConversationTree::pathTo(Handle handle) const
+{
+    std::vector<Handle> path;
+    for (Handle current = handle; current != NONE; current = nodes[current].parent)
+        path.push_back(current);
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+ConversationTree::Handle ConversationTree::lastLeaf(Handle handle) const
+{
+    while (handle != NONE && !nodes[handle].children.empty())
+        handle = nodes[handle].children.back();
+    return handle;
+}
+
+ConversationNodeView ConversationTree::view(Handle handle) const
+{
+    const ConversationNode &node = nodes[handle];
+    std::vector<std::string> childIds;
+    childIds.reserve(node.children.size());
+    for (Handle child : node.children)
+        childIds.push_back(nodes[child].id);
+    return ConversationNodeView(node, node.parent != NONE ? nodes[node.parent].id : "", std::move(childIds));
+}
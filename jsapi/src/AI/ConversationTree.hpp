@@ -0,0 +1,95 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ConversationNode.hpp"
+
+// A conversation held as an arena of nodes linked by integer handles.
+// Walking the tree indexes a vector; string ids are only looked up when
+// they come in from JS or the database. Slots of removed nodes are reused.
+class ConversationTree
+{
+public:
+    using Handle = ConversationNode::Handle;
+    static constexpr Handle NONE = ConversationNode::NONE;
+
+private:
+    std::vector<ConversationNode> nodes;
+    std::vector<Handle> freeSlots;
+    std::unordered_map<std::string, Handle> handles;
+
+public:
+    // Adds node as the last child of parent, or as a root when parent is NONE
+    Handle add(ConversationNode node, Handle parent);
+    // Links an added root under parent; used when loading, where rows may
+    // name a parent that appears later
+    void attach(Handle handle, Handle parent);
+    // Removes handle and everything below it, calling removed for each node first
+    template <typename Callback>
+    void removeSubtree(Handle handle, Callback removed);
+    void clear();
+
+    Handle find(const std::string &id) const;
+    bool contains(Handle handle) const { return handle < nodes.size() && !nodes[handle].id.empty(); }
+    ConversationNode &operator[](Handle handle) { return nodes[handle]; }
+    const ConversationNode &operator[](Handle handle) const { return nodes[handle]; }
+    size_t size() const { return handles.size(); }
+
+    // Handles from the root down to handle
+    std::vector<Handle> pathTo(Handle handle) const;
+    // Follows the last child of each node, the default branch
+    Handle lastLeaf(Handle handle) const;
+    ConversationNodeView view(Handle handle) const;
+
+    template <typename Callback>
+    void forEach(Callback callback)
+    {
+        for (auto &node : nodes)
+            if (!node.id.empty())
+                callback(node);
+    }
+};
+
+template <typename Callback>
+void ConversationTree::removeSubtree(Handle handle, Callback removed)
+{
+    Handle parent = nodes[handle].parent;
+    if (parent != NONE)
+    {
+        auto &siblings = nodes[parent].children;
+        siblings.erase(std::find(siblings.begin(), siblings.end(), handle));
+    }
+    std::vector<Handle> pending = {handle};
+    while (!pending.empty())
+    {
+        Handle current = pending.back();
+        pending.pop_back();
+        ConversationNode &node = nodes[current];
+        pending.insert(pending.end(), node.children.begin(), node.children.end());
+        removed(current, node);
+        handles.erase(node.id);
+        // An empty id marks the slot free; the node's buffers are released
+        node = ConversationNode("", ConversationNode::ROLE_USER, "");
+        node.id.clear();
+        freeSlots.push_back(current);
+    }
+}
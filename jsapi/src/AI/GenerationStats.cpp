@@ -0,0 +1,115 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "GenerationStats.hpp"
+#include <algorithm>
+
+GenerationStats &GenerationStats::instance()
+{
+    static GenerationStats generationStats;
+    return generationStats;
+}
+
+void GenerationStats::record(const GenerationSample &sample)
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    if (samples.size() < SAMPLE_CAPACITY)
+        samples.push_back(sample);
+    else
+        samples[next] = sample;
+    next = (next + 1) % SAMPLE_CAPACITY;
+}
+std::vector<GenerationSample> GenerationStats::getSamples() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    if (samples.size() < SAMPLE_CAPACITY)
+        return samples;
+    std::vector<GenerationSample> result(samples.begin() + next, samples.end());
+    result.insert(result.end(), samples.begin(), samples.begin() + next);
+    return result;
+}
+
+// Nearest-rank percentile; values is sorted in place
+static double percentile(std::vector<double> &values, double rank)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = std::min(values.size() - 1, (size_t)(rank / 100 * values.size()));
+    return values[index];
+}
+GenerationSummary GenerationStats::getSummary() const
+{
+    std::vector<GenerationSample> current = getSamples();
+    GenerationSummary summary;
+    summary.samples = current.size();
+    std::vector<double> firstToken, tokensPerSecond, persist, cancelLatency;
+    uint64_t tokens = 0, bytesWritten = 0;
+    size_t network = 0, hedged = 0, hedgesWon = 0;
+    for (const auto &sample : current)
+    {
+        tokens += sample.tokens;
+        bytesWritten += sample.bytesWritten;
+        persist.push_back(sample.persistUs / 1000.0);
+        if (sample.cancelLatencyUs > 0)
+            cancelLatency.push_back(sample.cancelLatencyUs / 1000.0);
+        // Cache hits would drown out what the network does
+        if (sample.cached)
+            continue;
+        network++;
+        if (sample.attempts > 1)
+        {
+            hedged++;
+            if (sample.winningAttempt > 0)
+                hedgesWon++;
+        }
+        if (sample.firstTokenUs == 0)
+            continue;
+        firstToken.push_back(sample.firstTokenUs / 1000.0);
+        if (sample.totalUs > sample.firstTokenUs && sample.tokens > 1)
+            tokensPerSecond.push_back(sample.tokens * 1e6 / (sample.totalUs - sample.firstTokenUs));
+    }
+    summary.firstTokenP50Ms = percentile(firstToken, 50);
+    summary.firstTokenP90Ms = percentile(firstToken, 90);
+    summary.firstTokenP99Ms = percentile(firstToken, 99);
+    summary.tokensPerSecondP50 = percentile(tokensPerSecond, 50);
+    summary.tokensPerSecondP10 = percentile(tokensPerSecond, 10);
+    summary.persistP50Ms = percentile(persist, 50);
+    summary.persistP90Ms = percentile(persist, 90);
+    summary.cancelLatencyP50Ms = percentile(cancelLatency, 50);
+    summary.cancelLatencyP90Ms = percentile(cancelLatency, 90);
+    summary.bytesWrittenPerToken = tokens > 0 ? (double)bytesWritten / tokens : 0;
+    summary.hedgedRate = network > 0 ? (double)hedged / network : 0;
+    summary.hedgeWinRate = hedged > 0 ? (double)hedgesWon / hedged : 0;
+    return summary;
+}
+double GenerationStats::firstTokenPercentileMs(double rank, size_t minSamples) const
+{
+    std::vector<double> firstToken;
+    for (const auto &sample : getSamples())
+        if (!sample.cached && sample.firstTokenUs > 0)
+            firstToken.push_back(sample.firstTokenUs / 1000.0);
+    if (firstToken.size() < minSamples)
+        return 0;
+    return percentile(firstToken, rank);
+}
+void GenerationStats::reset()
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    samples.clear();
+    next = 0;
+}
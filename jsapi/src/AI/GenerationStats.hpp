@@ -0,0 +1,87 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// One settled reply, as the user experienced it
+struct GenerationSample
+{
+    int64_t timestamp;
+    uint64_t firstTokenUs = 0;
+    uint64_t totalUs = 0;
+    // Estimated with strUtils::estimateTokens
+    uint64_t tokens = 0;
+    // Time spent writing the node and its draft
+    uint64_t persistUs = 0;
+    // Bytes SQLite wrote to files while the reply ran, as WriteCounter counts
+    // them. Writes of anything else running at the time are included, and a
+    // checkpoint or snapshot that comes after the reply is not.
+    uint64_t bytesWritten = 0;
+    // From the stop request to the reply being saved; 0 unless it was stopped
+    uint64_t cancelLatencyUs = 0;
+    int stopReason;
+    bool cached = false;
+    // Hedging: the delay the second attempt waited for (0 when hedging was
+    // off), how many attempts were sent, which one was used and when each
+    // received its first byte, measured from the start of the reply
+    uint64_t hedgeDelayUs = 0;
+    int attempts = 1;
+    int winningAttempt = 0;
+    uint64_t attemptFirstByteUs[2] = {};
+};
+
+struct GenerationSummary
+{
+    size_t samples = 0;
+    double firstTokenP50Ms = 0, firstTokenP90Ms = 0, firstTokenP99Ms = 0;
+    double tokensPerSecondP50 = 0, tokensPerSecondP10 = 0;
+    double persistP50Ms = 0, persistP90Ms = 0;
+    double cancelLatencyP50Ms = 0, cancelLatencyP90Ms = 0;
+    double bytesWrittenPerToken = 0;
+    // Of the replies that went to the network: the share that sent a hedge,
+    // and of those the share the hedge won
+    double hedgedRate = 0, hedgeWinRate = 0;
+};
+
+// The last SAMPLE_CAPACITY generations and percentiles over them, so latency
+// can be read off a device talking to the real API.
+class GenerationStats
+{
+private:
+    static constexpr size_t SAMPLE_CAPACITY = 128;
+
+    mutable std::mutex statsMutex;
+    std::vector<GenerationSample> samples;
+    size_t next = 0;
+
+    GenerationStats() = default;
+
+public:
+    static GenerationStats &instance();
+
+    void record(const GenerationSample &sample);
+    // Oldest first
+    std::vector<GenerationSample> getSamples() const;
+    GenerationSummary getSummary() const;
+    // Of first-token times that went to the network; 0 with fewer than minSamples
+    double firstTokenPercentileMs(double rank, size_t minSamples) const;
+    void reset();
+};
@@ -16,11 +16,29 @@
 // along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "JSAI.hpp"
+#include "strUtils.hpp"
 #include <iostream>
 
-JSAI::JSAI() : AIObject(nullptr) {}
+JSAI::JSAI()
+    : AIObject(nullptr),
+      streamPublisher([this](const std::string &topic, const std::string &payload)
+                      {
+                          std::vector<std::string> tags = strUtils::split(topic, std::string(1, TOPIC_SEPARATOR));
+                          ASSERT(tags.size() >= 3);
+                          Bson::object event{{"conversationId", tags[1]},
+                                             {"nodeId", tags[2]},
+                                             {"delta", payload}};
+                          if (tags.size() > 3)
+                              event["branch"] = std::stoi(tags[3]);
+                          publish(tags[0], event); },
+                      STREAM_PUBLISH_INTERVAL_MS) {}
 
-JSAI::~JSAI() {}
+JSAI::~JSAI()
+{
+    // The last deltas go out while this object can still publish them
+    streamPublisher.stop();
+    streamPublisher.flush();
+}
 
 void JSAI::initialize(JQFunctionInfo &info)
 {
@@ -43,7 +61,7 @@ void JSAI::getCurrentPath(JQFunctionInfo &info)
         AI *ai = getAIObject();
         ASSERT(ai != nullptr);
         ASSERT(info.Length() == 0);
-        std::vector<ConversationNode> path = ai->getCurrentPath();
+        std::vector<ConversationNodeView> path = ai->getCurrentPath();
         Bson::array result;
         for (const auto &msg : path)
         {
@@ -51,7 +69,7 @@ void JSAI::getCurrentPath(JQFunctionInfo &info)
                 {"id", msg.id},
                 {"role", msg.role},
                 {"stopReason", msg.stopReason},
-                {"content", msg.content},
+                {"content", *msg.content},
                 {"parentId", msg.parentId},
                 {"timestamp", std::to_string(msg.timestamp)}};
             Bson::array childIds;
@@ -166,14 +184,47 @@ void JSAI::generateResponse(JQAsyncInfo &info)
     {
         ASSERT(AIObject != nullptr);
         ASSERT(info.Length() == 0);
-        AIStreamCallback callback = [this](const std::string &messageDelta)
+        AIStreamCallback callback = [this](const std::string &conversationId, const std::string &nodeId,
+                                           const std::string &messageDelta)
         {
-            publish("ai_stream", messageDelta);
+            streamPublisher.append(std::string(STREAM_TOPIC) + TOPIC_SEPARATOR + conversationId + TOPIC_SEPARATOR + nodeId,
+                                   messageDelta);
         };
-        info.post(AIObject->generateResponse(callback));
+        std::string response = AIObject->generateResponse(callback);
+        streamPublisher.flush();
+        info.post(response);
     }
     catch (const std::exception &e)
     {
+        streamPublisher.flush();
+        info.postError(e.what());
+    }
+}
+void JSAI::generateAlternatives(JQAsyncInfo &info)
+{
+    try
+    {
+        ASSERT(AIObject != nullptr);
+        ASSERT(info.Length() == 1);
+        ASSERT(info[0].is_number());
+        int count = info[0].int_value();
+        ASSERT(count > 0);
+        AIBranchStreamCallback callback = [this](const std::string &conversationId, const std::string &nodeId,
+                                                 size_t branch, const std::string &messageDelta)
+        {
+            streamPublisher.append(std::string(ALTERNATIVE_TOPIC) + TOPIC_SEPARATOR + conversationId + TOPIC_SEPARATOR + nodeId +
+                                       TOPIC_SEPARATOR + std::to_string(branch),
+                                   messageDelta);
+        };
+        Bson::array responses;
+        for (const auto &response : AIObject->generateAlternatives(count, callback))
+            responses.push_back(response);
+        streamPublisher.flush();
+        info.post(responses);
+    }
+    catch (const std::exception &e)
+    {
+        streamPublisher.flush();
         info.postError(e.what());
     }
 }
@@ -183,7 +234,13 @@ void JSAI::stopGeneration(JQFunctionInfo &info)
     {
         AI *ai = getAIObject();
         ASSERT(ai != nullptr);
-        ASSERT(info.Length() == 0);
+        ASSERT(info.Length() <= 1);
+        if (info.Length() == 1)
+        {
+            JSContext *ctx = info.GetContext();
+            info.GetReturnValue().Set(ai->stopGeneration(JQString(ctx, info[0]).getString()));
+            return;
+        }
         ai->stopGeneration();
         info.GetReturnValue().Set(true);
     }
@@ -192,14 +249,53 @@ void JSAI::stopGeneration(JQFunctionInfo &info)
         info.GetReturnValue().ThrowInternalError(e.what());
     }
 }
+void JSAI::stopAlternative(JQFunctionInfo &info)
+{
+    try
+    {
+        AI *ai = getAIObject();
+        ASSERT(ai != nullptr);
+        ASSERT(info.Length() == 1);
+        JSContext *ctx = info.GetContext();
+        int branch = JQNumber(ctx, info[0]).getInt32();
+        ASSERT(branch >= 0);
+        info.GetReturnValue().Set(ai->stopAlternative(branch));
+    }
+    catch (const std::exception &e)
+    {
+        info.GetReturnValue().ThrowInternalError(e.what());
+    }
+}
+void JSAI::setStreamPublishInterval(JQFunctionInfo &info)
+{
+    try
+    {
+        ASSERT(info.Length() == 1);
+        JSContext *ctx = info.GetContext();
+        int intervalMs = JQNumber(ctx, info[0]).getInt32();
+        ASSERT(intervalMs >= 0);
+        streamPublisher.setInterval(intervalMs);
+        info.GetReturnValue().Set(true);
+    }
+    catch (const std::exception &e)
+    {
+        info.GetReturnValue().ThrowInternalError(e.what());
+    }
+}
 void JSAI::getModels(JQAsyncInfo &info)
 {
     try
     {
         ASSERT(AIObject != nullptr);
-        ASSERT(info.Length() == 0);
+        ASSERT(info.Length() <= 1);
+        bool refresh = false;
+        if (info.Length() == 1)
+        {
+            ASSERT(info[0].is_bool());
+            refresh = info[0].bool_value();
+        }
         Bson::array modelsArray;
-        for (const auto &model : AIObject->getModels())
+        for (const auto &model : AIObject->getModels(refresh))
             modelsArray.push_back(model);
         info.post(modelsArray);
     }
@@ -213,8 +309,14 @@ void JSAI::getUserBalance(JQAsyncInfo &info)
     try
     {
         ASSERT(AIObject != nullptr);
-        ASSERT(info.Length() == 0);
-        info.post(AIObject->getUserBalance());
+        ASSERT(info.Length() <= 1);
+        bool refresh = false;
+        if (info.Length() == 1)
+        {
+            ASSERT(info[0].is_bool());
+            refresh = info[0].bool_value();
+        }
+        info.post(AIObject->getUserBalance(refresh));
     }
     catch (const std::exception &e)
     {
@@ -227,16 +329,33 @@ void JSAI::getConversationList(JQAsyncInfo &info)
     try
     {
         ASSERT(AIObject != nullptr);
-        ASSERT(info.Length() == 0);
+        ASSERT(info.Length() <= 3);
+        long long afterUpdatedAt = LLONG_MAX;
+        std::string afterId;
+        int limit = 20;
+        if (info.Length() >= 2 && info[0].is_string() && !info[0].string_value().empty())
+        {
+            ASSERT(info[1].is_string());
+            afterUpdatedAt = std::stoll(info[0].string_value());
+            afterId = info[1].string_value();
+        }
+        if (info.Length() == 3)
+        {
+            ASSERT(info[2].is_number());
+            limit = info[2].int_value();
+        }
+        ASSERT(limit > 0);
         Bson::array conversationsArray;
-        auto response = AIObject->getConversationList();
+        auto response = AIObject->getConversationList(afterUpdatedAt, afterId, limit);
         for (const auto &conv : response)
         {
             conversationsArray.push_back(Bson::object{
                 {"id", conv.id},
                 {"title", conv.title},
                 {"createdAt", std::to_string(conv.createdAt)},
-                {"updatedAt", std::to_string(conv.updatedAt)}});
+                {"updatedAt", std::to_string(conv.updatedAt)},
+                {"messageCount", conv.messageCount},
+                {"preview", conv.preview}});
         }
         info.post(conversationsArray);
     }
@@ -318,12 +437,75 @@ void JSAI::updateConversationTitle(JQAsyncInfo &info)
     }
 }
 
+void JSAI::searchConversations(JQAsyncInfo &info)
+{
+    try
+    {
+        ASSERT(AIObject != nullptr);
+        ASSERT(info.Length() == 1 || info.Length() == 2);
+        ASSERT(info[0].is_string());
+        std::string query = info[0].string_value();
+        int limit = 20;
+        if (info.Length() == 2)
+        {
+            ASSERT(info[1].is_number());
+            limit = info[1].int_value();
+        }
+        ASSERT(limit > 0);
+        Bson::array resultsArray;
+        for (const auto &result : AIObject->searchConversations(query, limit))
+            resultsArray.push_back(Bson::object{
+                {"id", result.conversationId},
+                {"title", result.title},
+                {"snippet", result.snippet},
+                {"updatedAt", std::to_string(result.updatedAt)}});
+        info.post(resultsArray);
+    }
+    catch (const std::exception &e)
+    {
+        info.postError(e.what());
+    }
+}
+
+void JSAI::readNodeContent(JQAsyncInfo &info)
+{
+    try
+    {
+        ASSERT(AIObject != nullptr);
+        ASSERT(info.Length() >= 1 && info.Length() <= 3);
+        ASSERT(info[0].is_string());
+        std::string nodeId = info[0].string_value();
+        int offset = 0, length = 16384;
+        if (info.Length() >= 2)
+        {
+            ASSERT(info[1].is_number());
+            offset = info[1].int_value();
+        }
+        if (info.Length() == 3)
+        {
+            ASSERT(info[2].is_number());
+            length = info[2].int_value();
+        }
+        ASSERT(offset >= 0 && length > 0);
+        size_t totalLength = 0, nextOffset = 0;
+        std::string content = AIObject->readNodeContent(nodeId, offset, length, totalLength, nextOffset);
+        info.post(Bson::object{
+            {"content", content},
+            {"nextOffset", (double)nextOffset},
+            {"totalLength", (double)totalLength}});
+    }
+    catch (const std::exception &e)
+    {
+        info.postError(e.what());
+    }
+}
+
 void JSAI::setSettings(JQFunctionInfo &info)
 {
     try
     {
         ASSERT(AIObject != nullptr);
-        ASSERT(info.Length() == 7);
+        ASSERT(info.Length() == 7 || info.Length() == 8);
         JSContext *ctx = info.GetContext();
         std::string apiKey = JQString(ctx, info[0]).getString();
         std::string baseUrl = JQString(ctx, info[1]).getString();
@@ -332,8 +514,11 @@ void JSAI::setSettings(JQFunctionInfo &info)
         double temperature = JQNumber(ctx, info[4]).getDouble();
         double topP = JQNumber(ctx, info[5]).getDouble();
         std::string systemPrompt = JQString(ctx, info[6]).getString();
+        int contextTokens = info.Length() == 8 ? JQNumber(ctx, info[7]).getInt32()
+                                               : AIObject->getSettings().contextTokens;
+        ASSERT(contextTokens > 0);
 
-        AIObject->setSettings(apiKey, baseUrl, modelName, maxTokens, temperature, topP, systemPrompt);
+        AIObject->setSettings(apiKey, baseUrl, modelName, maxTokens, temperature, topP, systemPrompt, contextTokens);
         info.GetReturnValue().Set(true);
     }
     catch (const std::exception &e)
@@ -355,7 +540,221 @@ void JSAI::getSettings(JQFunctionInfo &info)
             {"maxTokens", settings.maxTokens},
             {"temperature", settings.temperature},
             {"topP", settings.topP},
-            {"systemPrompt", settings.systemPrompt}});
+            {"systemPrompt", settings.systemPrompt},
+            {"contextTokens", settings.contextTokens}});
+    }
+    catch (const std::exception &e)
+    {
+        info.GetReturnValue().ThrowInternalError(e.what());
+    }
+}
+void JSAI::setResponseCache(JQFunctionInfo &info)
+{
+    try
+    {
+        AI *ai = getAIObject();
+        ASSERT(ai != nullptr);
+        ASSERT(info.Length() == 1 || info.Length() == 2);
+        JSContext *ctx = info.GetContext();
+        bool enabled = JQBool(ctx, info[0]).getBool();
+        double capacityBytes = info.Length() == 2 ? JQNumber(ctx, info[1]).getDouble()
+                                                  : (double)ai->getResponseCacheInfo().capacityBytes;
+        ASSERT(capacityBytes >= 0);
+        ai->setResponseCache(enabled, capacityBytes);
+        info.GetReturnValue().Set(true);
+    }
+    catch (const std::exception &e)
+    {
+        info.GetReturnValue().ThrowInternalError(e.what());
+    }
+}
+void JSAI::getResponseCacheInfo(JQFunctionInfo &info)
+{
+    try
+    {
+        AI *ai = getAIObject();
+        ASSERT(ai != nullptr);
+        ASSERT(info.Length() == 0);
+        ResponseCache::Info cacheInfo = ai->getResponseCacheInfo();
+        info.GetReturnValue().Set(Bson::object{
+            {"enabled", cacheInfo.enabled},
+            {"capacityBytes", (double)cacheInfo.capacityBytes},
+            {"usedBytes", (double)cacheInfo.usedBytes},
+            {"entries", (double)cacheInfo.entries}});
+    }
+    catch (const std::exception &e)
+    {
+        info.GetReturnValue().ThrowInternalError(e.what());
+    }
+}
+void JSAI::clearResponseCache(JQFunctionInfo &info)
+{
+    try
+    {
+        AI *ai = getAIObject();
+        ASSERT(ai != nullptr);
+        ASSERT(info.Length() == 0);
+        ai->clearResponseCache();
+        info.GetReturnValue().Set(true);
+    }
+    catch (const std::exception &e)
+    {
+        info.GetReturnValue().ThrowInternalError(e.what());
+    }
+}
+void JSAI::setHedging(JQFunctionInfo &info)
+{
+    try
+    {
+        AI *ai = getAIObject();
+        ASSERT(ai != nullptr);
+        ASSERT(info.Length() == 1 || info.Length() == 2);
+        JSContext *ctx = info.GetContext();
+        bool enabled = JQBool(ctx, info[0]).getBool();
+        double percentile = info.Length() == 2 ? JQNumber(ctx, info[1]).getDouble()
+                                               : ai->getHedging().percentile;
+        ASSERT(percentile > 0 && percentile <= 100);
+        ai->setHedging(enabled, percentile);
+        info.GetReturnValue().Set(true);
+    }
+    catch (const std::exception &e)
+    {
+        info.GetReturnValue().ThrowInternalError(e.what());
+    }
+}
+void JSAI::getHedging(JQFunctionInfo &info)
+{
+    try
+    {
+        AI *ai = getAIObject();
+        ASSERT(ai != nullptr);
+        ASSERT(info.Length() == 0);
+        AI::HedgeInfo hedgeInfo = ai->getHedging();
+        info.GetReturnValue().Set(Bson::object{
+            {"enabled", hedgeInfo.enabled},
+            {"percentile", hedgeInfo.percentile},
+            {"delayMs", (double)hedgeInfo.delayMs}});
+    }
+    catch (const std::exception &e)
+    {
+        info.GetReturnValue().ThrowInternalError(e.what());
+    }
+}
+
+void JSAI::getQueryStats(JQFunctionInfo &info)
+{
+    try
+    {
+        ASSERT(info.Length() == 0);
+        Bson::array queries;
+        for (const auto &stat : QueryStats::instance().getStats())
+            queries.push_back(Bson::object{
+                {"sql", stat.sql},
+                {"calls", (double)stat.calls},
+                {"rows", (double)stat.rows},
+                {"totalUs", (double)stat.totalUs},
+                {"maxUs", (double)stat.maxUs},
+                {"prepareUs", (double)stat.prepareUs},
+                {"stepUs", (double)stat.stepUs}});
+        Bson::array slowQueries;
+        for (const auto &slowQuery : QueryStats::instance().getSlowQueries())
+            slowQueries.push_back(Bson::object{
+                {"sql", slowQuery.sql},
+                {"durationUs", (double)slowQuery.durationUs},
+                {"timestamp", std::to_string(slowQuery.timestamp)}});
+        info.GetReturnValue().Set(Bson::object{
+            {"queries", queries},
+            {"slowQueries", slowQueries}});
+    }
+    catch (const std::exception &e)
+    {
+        info.GetReturnValue().ThrowInternalError(e.what());
+    }
+}
+void JSAI::resetQueryStats(JQFunctionInfo &info)
+{
+    try
+    {
+        ASSERT(info.Length() == 0);
+        QueryStats::instance().reset();
+        info.GetReturnValue().Set(true);
+    }
+    catch (const std::exception &e)
+    {
+        info.GetReturnValue().ThrowInternalError(e.what());
+    }
+}
+void JSAI::setSlowQueryLog(JQFunctionInfo &info)
+{
+    try
+    {
+        ASSERT(info.Length() == 2);
+        JSContext *ctx = info.GetContext();
+        double thresholdMs = JQNumber(ctx, info[0]).getDouble();
+        int capacity = JQNumber(ctx, info[1]).getInt32();
+        ASSERT(thresholdMs >= 0);
+        ASSERT(capacity >= 0);
+        QueryStats::instance().setSlowQueryLog(thresholdMs * 1000, capacity);
+        info.GetReturnValue().Set(true);
+    }
+    catch (const std::exception &e)
+    {
+        info.GetReturnValue().ThrowInternalError(e.what());
+    }
+}
+
+void JSAI::getGenerationStats(JQFunctionInfo &info)
+{
+    try
+    {
+        ASSERT(info.Length() == 0);
+        Bson::array samples;
+        for (const auto &sample : GenerationStats::instance().getSamples())
+            samples.push_back(Bson::object{
+                {"timestamp", std::to_string(sample.timestamp)},
+                {"firstTokenUs", (double)sample.firstTokenUs},
+                {"totalUs", (double)sample.totalUs},
+                {"tokens", (double)sample.tokens},
+                {"persistUs", (double)sample.persistUs},
+                {"bytesWritten", (double)sample.bytesWritten},
+                {"cancelLatencyUs", (double)sample.cancelLatencyUs},
+                {"stopReason", sample.stopReason},
+                {"cached", sample.cached},
+                {"hedgeDelayUs", (double)sample.hedgeDelayUs},
+                {"attempts", sample.attempts},
+                {"winningAttempt", sample.winningAttempt},
+                {"attemptFirstByteUs", Bson::array{(double)sample.attemptFirstByteUs[0],
+                                                   (double)sample.attemptFirstByteUs[1]}}});
+        GenerationSummary summary = GenerationStats::instance().getSummary();
+        info.GetReturnValue().Set(Bson::object{
+            {"samples", samples},
+            {"summary", Bson::object{
+                            {"samples", (double)summary.samples},
+                            {"firstTokenP50Ms", summary.firstTokenP50Ms},
+                            {"firstTokenP90Ms", summary.firstTokenP90Ms},
+                            {"firstTokenP99Ms", summary.firstTokenP99Ms},
+                            {"tokensPerSecondP50", summary.tokensPerSecondP50},
+                            {"tokensPerSecondP10", summary.tokensPerSecondP10},
+                            {"persistP50Ms", summary.persistP50Ms},
+                            {"persistP90Ms", summary.persistP90Ms},
+                            {"cancelLatencyP50Ms", summary.cancelLatencyP50Ms},
+                            {"cancelLatencyP90Ms", summary.cancelLatencyP90Ms},
+                            {"bytesWrittenPerToken", summary.bytesWrittenPerToken},
+                            {"hedgedRate", summary.hedgedRate},
+                            {"hedgeWinRate", summary.hedgeWinRate}}}});
+    }
+    catch (const std::exception &e)
+    {
+        info.GetReturnValue().ThrowInternalError(e.what());
+    }
+}
+void JSAI::resetGenerationStats(JQFunctionInfo &info)
+{
+    try
+    {
+        ASSERT(info.Length() == 0);
+        GenerationStats::instance().reset();
+        info.GetReturnValue().Set(true);
     }
     catch (const std::exception &e)
     {
@@ -379,7 +778,10 @@ extern JSValue createAI(JQModuleEnv *env)
 
     tpl->SetProtoMethodPromise("addUserMessage", &JSAI::addUserMessage);
     tpl->SetProtoMethodPromise("generateResponse", &JSAI::generateResponse);
+    tpl->SetProtoMethodPromise("generateAlternatives", &JSAI::generateAlternatives);
     tpl->SetProtoMethod("stopGeneration", &JSAI::stopGeneration);
+    tpl->SetProtoMethod("stopAlternative", &JSAI::stopAlternative);
+    tpl->SetProtoMethod("setStreamPublishInterval", &JSAI::setStreamPublishInterval);
     tpl->SetProtoMethodPromise("getModels", &JSAI::getModels);
     tpl->SetProtoMethodPromise("getUserBalance", &JSAI::getUserBalance);
 
@@ -388,9 +790,23 @@ extern JSValue createAI(JQModuleEnv *env)
     tpl->SetProtoMethodPromise("loadConversation", &JSAI::loadConversation);
     tpl->SetProtoMethodPromise("deleteConversation", &JSAI::deleteConversation);
     tpl->SetProtoMethodPromise("updateConversationTitle", &JSAI::updateConversationTitle);
+    tpl->SetProtoMethodPromise("searchConversations", &JSAI::searchConversations);
+    tpl->SetProtoMethodPromise("readNodeContent", &JSAI::readNodeContent);
 
     tpl->SetProtoMethod("setSettings", &JSAI::setSettings);
     tpl->SetProtoMethod("getSettings", &JSAI::getSettings);
+    tpl->SetProtoMethod("setResponseCache", &JSAI::setResponseCache);
+    tpl->SetProtoMethod("getResponseCacheInfo", &JSAI::getResponseCacheInfo);
+    tpl->SetProtoMethod("clearResponseCache", &JSAI::clearResponseCache);
+    tpl->SetProtoMethod("setHedging", &JSAI::setHedging);
+    tpl->SetProtoMethod("getHedging", &JSAI::getHedging);
+
+    tpl->SetProtoMethod("getQueryStats", &JSAI::getQueryStats);
+    tpl->SetProtoMethod("resetQueryStats", &JSAI::resetQueryStats);
+    tpl->SetProtoMethod("setSlowQueryLog", &JSAI::setSlowQueryLog);
+
+    tpl->SetProtoMethod("getGenerationStats", &JSAI::getGenerationStats);
+    tpl->SetProtoMethod("resetGenerationStats", &JSAI::resetGenerationStats);
 
     JSAI::InitTpl(tpl);
     return tpl->CallConstructor();
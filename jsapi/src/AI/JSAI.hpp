@@ -18,6 +18,7 @@
 #pragma once
 
 #include "AI.hpp"
+#include "PublishCoalescer.hpp"
 #include <jqutil_v2/jqutil.h>
 #include <memory>
 #include <mutex>
@@ -27,8 +28,18 @@ using namespace JQUTIL_NS;
 class JSAI : public JQPublishObject
 {
 private:
+    // Stream deltas reach the page at most once per this many milliseconds
+    static constexpr size_t STREAM_PUBLISH_INTERVAL_MS = 40;
+    // Coalescer topics are <event>#<conversationId>#<nodeId>, followed by
+    // #<branch> for alternatives, so concurrent streams are never merged; they
+    // are published as the event with those tags in the payload
+    static constexpr char STREAM_TOPIC[] = "ai_stream";
+    static constexpr char ALTERNATIVE_TOPIC[] = "ai_alternative";
+    static constexpr char TOPIC_SEPARATOR = '#';
+
     std::unique_ptr<AI> AIObject;
     mutable std::mutex aiObjectMutex;
+    PublishCoalescer streamPublisher;
 
     AI *getAIObject() const
     {
@@ -50,7 +61,10 @@ public:
 
     void addUserMessage(JQAsyncInfo &info);
     void generateResponse(JQAsyncInfo &info);
+    void generateAlternatives(JQAsyncInfo &info);
     void stopGeneration(JQFunctionInfo &info);
+    void stopAlternative(JQFunctionInfo &info);
+    void setStreamPublishInterval(JQFunctionInfo &info);
     void getModels(JQAsyncInfo &info);
     void getUserBalance(JQAsyncInfo &info);
 
@@ -59,9 +73,23 @@ public:
     void loadConversation(JQAsyncInfo &info);
     void deleteConversation(JQAsyncInfo &info);
     void updateConversationTitle(JQAsyncInfo &info);
+    void searchConversations(JQAsyncInfo &info);
+    void readNodeContent(JQAsyncInfo &info);
 
     void setSettings(JQFunctionInfo &info);
     void getSettings(JQFunctionInfo &info);
+    void setResponseCache(JQFunctionInfo &info);
+    void getResponseCacheInfo(JQFunctionInfo &info);
+    void clearResponseCache(JQFunctionInfo &info);
+    void setHedging(JQFunctionInfo &info);
+    void getHedging(JQFunctionInfo &info);
+
+    void getQueryStats(JQFunctionInfo &info);
+    void resetQueryStats(JQFunctionInfo &info);
+    void setSlowQueryLog(JQFunctionInfo &info);
+
+    void getGenerationStats(JQFunctionInfo &info);
+    void resetGenerationStats(JQFunctionInfo &info);
 };
 
 extern JSValue createAI(JQModuleEnv *env);
@@ -0,0 +1,168 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "ResponseCache.hpp"
+#include "strUtils.hpp"
+#include <algorithm>
+#include <vector>
+
+ResponseCache::ResponseCache()
+    : database(DATABASE_DIR "langningchen-ai-cache.db")
+{
+    database.table("response_cache")
+        .column("key", TABLE::TEXT, TABLE::PRIMARY_KEY)
+        .column("content", TABLE::TEXT, TABLE::NOT_NULL | TABLE::COMPRESSED)
+        .column("stop_reason", TABLE::INTEGER, TABLE::NOT_NULL)
+        .column("size", TABLE::INTEGER, TABLE::NOT_NULL)
+        .column("last_used", TABLE::INTEGER, TABLE::NOT_NULL)
+        .index({"last_used", "size", "key"})
+        .execute();
+    database.table("response_cache_settings")
+        .column("id", TABLE::TEXT, TABLE::PRIMARY_KEY)
+        .column("enabled", TABLE::INTEGER, TABLE::NOT_NULL)
+        .column("capacity_bytes", TABLE::INTEGER, TABLE::NOT_NULL)
+        .execute();
+
+    auto settings = database.select("response_cache_settings")
+                        .where("id", "default")
+                        .execute();
+    if (!settings.empty())
+    {
+        enabled = std::stoi(settings[0].at("enabled")) != 0;
+        capacityBytes = std::stoull(settings[0].at("capacity_bytes"));
+    }
+    auto totals = database.query("SELECT COUNT(*) AS entries, COALESCE(SUM(size), 0) AS used_bytes, "
+                                 "COALESCE(MAX(last_used), 0) AS last_used FROM response_cache")
+                      .execute();
+    entries = std::stoull(totals[0].at("entries"));
+    usedBytes = std::stoull(totals[0].at("used_bytes"));
+    nextUse = std::stoll(totals[0].at("last_used")) + 1;
+}
+
+std::string ResponseCache::key(const std::string &endpoint, const std::string &requestBody)
+{
+    // The body is hashed in place; the NUL keeps endpoint and digest apart
+    return strUtils::hash128(endpoint + '\0' + strUtils::hash128(requestBody));
+}
+
+bool ResponseCache::isEnabled() const
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return enabled;
+}
+void ResponseCache::configure(bool enabled, size_t capacityBytes)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    this->enabled = enabled;
+    this->capacityBytes = capacityBytes;
+    saveSettings();
+    evict();
+}
+ResponseCache::Info ResponseCache::info() const
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return Info{enabled, capacityBytes, usedBytes, entries};
+}
+
+bool ResponseCache::lookup(const std::string &key, Entry &entry)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (!enabled)
+        return false;
+    auto rows = database.select("response_cache")
+                    .where("key", key)
+                    .execute();
+    if (rows.empty())
+        return false;
+    entry.content = rows[0].at("content");
+    entry.stopReason = static_cast<ConversationNode::STOP_REASON>(std::stoi(rows[0].at("stop_reason")));
+    database.update("response_cache")
+        .set("last_used", nextUse++)
+        .where("key", key)
+        .execute();
+    return true;
+}
+void ResponseCache::store(const std::string &key, const std::string &content, ConversationNode::STOP_REASON stopReason)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (!enabled || content.size() > capacityBytes)
+        return;
+    TRANSACTION transaction = database.transaction();
+    auto existing = database.query("SELECT size FROM response_cache WHERE key = ?")
+                        .bind(key)
+                        .execute();
+    if (!existing.empty())
+    {
+        database.remove("response_cache")
+            .where("key", key)
+            .execute();
+        usedBytes -= std::stoull(existing[0].at("size"));
+        entries--;
+    }
+    database.insert("response_cache")
+        .value("key", key)
+        .value("content", content)
+        .value("stop_reason", (int)stopReason)
+        .value("size", content.size())
+        .value("last_used", nextUse++)
+        .execute();
+    transaction.commit();
+    usedBytes += content.size();
+    entries++;
+    evict();
+}
+void ResponseCache::clear()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    database.remove("response_cache").execute();
+    usedBytes = entries = 0;
+}
+
+// Caller holds cacheMutex
+void ResponseCache::evict()
+{
+    if (usedBytes <= capacityBytes)
+        return;
+    size_t excess = usedBytes - capacityBytes, freed = 0;
+    std::vector<std::string> victims;
+    database.query("SELECT key, size FROM response_cache ORDER BY last_used")
+        .forEach([&](const std::unordered_map<std::string, std::string> &row)
+                 {
+                     victims.push_back(row.at("key"));
+                     freed += std::stoull(row.at("size"));
+                     return freed < excess; });
+    TRANSACTION transaction = database.transaction();
+    for (const auto &victim : victims)
+        database.remove("response_cache")
+            .where("key", victim)
+            .execute();
+    transaction.commit();
+    usedBytes -= std::min(freed, usedBytes);
+    entries -= std::min(victims.size(), entries);
+}
+// Caller holds cacheMutex
+void ResponseCache::saveSettings()
+{
+    TRANSACTION transaction = database.transaction();
+    database.remove("response_cache_settings").execute();
+    database.insert("response_cache_settings")
+        .value("id", "default")
+        .value("enabled", enabled ? 1 : 0)
+        .value("capacity_bytes", capacityBytes)
+        .execute();
+    transaction.commit();
+}
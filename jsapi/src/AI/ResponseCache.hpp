@@ -0,0 +1,70 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <mutex>
+#include "Database/Database.hpp"
+#include "ConversationNode.hpp"
+
+// Replies to deterministic requests, keyed by a hash of everything that
+// decides the reply (endpoint, model, parameters and messages). Off until
+// enabled; entries beyond capacityBytes are evicted least recently used first.
+// Lives in its own file so it can be thrown away without touching conversations.
+class ResponseCache
+{
+public:
+    struct Entry
+    {
+        std::string content;
+        ConversationNode::STOP_REASON stopReason;
+    };
+    struct Info
+    {
+        bool enabled;
+        size_t capacityBytes;
+        size_t usedBytes;
+        size_t entries;
+    };
+    static constexpr size_t DEFAULT_CAPACITY_BYTES = 4 * 1024 * 1024;
+
+private:
+    DATABASE database;
+    mutable std::mutex cacheMutex;
+    bool enabled = false;
+    size_t capacityBytes = DEFAULT_CAPACITY_BYTES;
+    size_t usedBytes = 0;
+    size_t entries = 0;
+    // Recency stamp for the next hit or store; larger is more recent
+    long long nextUse = 0;
+
+    void evict();
+    void saveSettings();
+
+public:
+    ResponseCache();
+
+    static std::string key(const std::string &endpoint, const std::string &requestBody);
+
+    bool isEnabled() const;
+    void configure(bool enabled, size_t capacityBytes);
+    Info info() const;
+    bool lookup(const std::string &key, Entry &entry);
+    void store(const std::string &key, const std::string &content, ConversationNode::STOP_REASON stopReason);
+    void clear();
+};
@@ -0,0 +1,488 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "StreamDelta.hpp"
+#include <nlohmann/json.hpp>
+#include <cstdint>
+
+namespace
+{
+    static constexpr int MAX_DEPTH = 32;
+
+    // Minimal JSON reader over a single buffer. Every method returns false
+    // on input it does not understand, which sends the caller to the full
+    // parser rather than guessing.
+    class DeltaScanner
+    {
+    private:
+        const char *pos;
+        const char *end;
+
+        static void appendUtf8(std::string &out, uint32_t codePoint)
+        {
+            if (codePoint < 0x80)
+                out += static_cast<char>(codePoint);
+            else if (codePoint < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (codePoint >> 6));
+                out += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+            else if (codePoint < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (codePoint >> 12));
+                out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (codePoint >> 18));
+                out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+        }
+
+        bool readHex4(uint32_t &value)
+        {
+            if (end - pos < 4)
+                return false;
+            value = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                char c = *pos++;
+                value <<= 4;
+                if (c >= '0' && c <= '9')
+                    value |= c - '0';
+                else if (c >= 'a' && c <= 'f')
+                    value |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F')
+                    value |= c - 'A' + 10;
+                else
+                    return false;
+            }
+            return true;
+        }
+
+        // Malformed UTF-8 is rejected like the full parser does
+        bool skipUtf8Sequence()
+        {
+            unsigned char lead = *pos;
+            size_t length;
+            unsigned char low = 0x80, high = 0xBF;
+            if (lead >= 0xC2 && lead <= 0xDF)
+                length = 2;
+            else if (lead >= 0xE0 && lead <= 0xEF)
+            {
+                length = 3;
+                if (lead == 0xE0)
+                    low = 0xA0;
+                else if (lead == 0xED)
+                    high = 0x9F;
+            }
+            else if (lead >= 0xF0 && lead <= 0xF4)
+            {
+                length = 4;
+                if (lead == 0xF0)
+                    low = 0x90;
+                else if (lead == 0xF4)
+                    high = 0x8F;
+            }
+            else
+                return false;
+            if (static_cast<size_t>(end - pos) < length)
+                return false;
+            unsigned char second = pos[1];
+            if (second < low || second > high)
+                return false;
+            for (size_t i = 2; i < length; i++)
+                if ((static_cast<unsigned char>(pos[i]) & 0xC0) != 0x80)
+                    return false;
+            pos += length;
+            return true;
+        }
+
+    public:
+        explicit DeltaScanner(std::string_view json) : pos(json.data()), end(json.data() + json.size()) {}
+
+        void skipWhitespace()
+        {
+            while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r'))
+                pos++;
+        }
+        bool atEnd()
+        {
+            skipWhitespace();
+            return pos == end;
+        }
+        bool consume(char c)
+        {
+            skipWhitespace();
+            if (pos < end && *pos == c)
+            {
+                pos++;
+                return true;
+            }
+            return false;
+        }
+        bool peek(char c)
+        {
+            skipWhitespace();
+            return pos < end && *pos == c;
+        }
+
+        // Reads a string; out may be null to skip it. Escapes are only
+        // decoded when the value is kept.
+        bool readString(std::string *out)
+        {
+            if (!consume('"'))
+                return false;
+            while (true)
+            {
+                const char *runStart = pos;
+                while (pos < end && *pos != '"' && *pos != '\\' && static_cast<unsigned char>(*pos) >= 0x20)
+                {
+                    if (static_cast<unsigned char>(*pos) < 0x80)
+                        pos++;
+                    else if (!skipUtf8Sequence())
+                        return false;
+                }
+                if (out)
+                    out->append(runStart, pos - runStart);
+                if (pos == end || static_cast<unsigned char>(*pos) < 0x20)
+                    return false;
+                if (*pos++ == '"')
+                    return true;
+                if (pos == end)
+                    return false;
+                char escape = *pos++;
+                char decoded;
+                switch (escape)
+                {
+                case '"':
+                case '\\':
+                case '/':
+                    decoded = escape;
+                    break;
+                case 'b':
+                    decoded = '\b';
+                    break;
+                case 'f':
+                    decoded = '\f';
+                    break;
+                case 'n':
+                    decoded = '\n';
+                    break;
+                case 'r':
+                    decoded = '\r';
+                    break;
+                case 't':
+                    decoded = '\t';
+                    break;
+                case 'u':
+                {
+                    uint32_t codePoint;
+                    if (!readHex4(codePoint))
+                        return false;
+                    if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+                    {
+                        uint32_t low;
+                        if (end - pos < 2 || pos[0] != '\\' || pos[1] != 'u')
+                            return false;
+                        pos += 2;
+                        if (!readHex4(low) || low < 0xDC00 || low > 0xDFFF)
+                            return false;
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF)
+                        return false;
+                    if (out)
+                        appendUtf8(*out, codePoint);
+                    continue;
+                }
+                default:
+                    return false;
+                }
+                if (out)
+                    *out += decoded;
+            }
+        }
+
+        // Object keys in chunks are plain ASCII; an escaped key is left to
+        // the full parser
+        bool readKey(std::string_view &key)
+        {
+            if (!consume('"'))
+                return false;
+            const char *start = pos;
+            while (pos < end && *pos != '"' && *pos != '\\')
+                pos++;
+            if (pos == end || *pos == '\\')
+                return false;
+            key = std::string_view(start, pos - start);
+            pos++;
+            return consume(':');
+        }
+
+        bool readLiteral(std::string_view literal)
+        {
+            skipWhitespace();
+            if (static_cast<size_t>(end - pos) >= literal.size() && std::string_view(pos, literal.size()) == literal)
+            {
+                pos += literal.size();
+                return true;
+            }
+            return false;
+        }
+        bool readNull() { return readLiteral("null"); }
+
+        bool readDigits()
+        {
+            const char *start = pos;
+            while (pos < end && *pos >= '0' && *pos <= '9')
+                pos++;
+            return pos != start;
+        }
+        bool readNumber()
+        {
+            if (pos < end && *pos == '-')
+                pos++;
+            if (pos < end && *pos == '0')
+                pos++;
+            else if (!readDigits())
+                return false;
+            if (pos < end && *pos == '.')
+            {
+                pos++;
+                if (!readDigits())
+                    return false;
+            }
+            if (pos < end && (*pos == 'e' || *pos == 'E'))
+            {
+                pos++;
+                if (pos < end && (*pos == '+' || *pos == '-'))
+                    pos++;
+                if (!readDigits())
+                    return false;
+            }
+            return true;
+        }
+
+        // Reads a string or null into out; hasValue tells them apart
+        bool readOptionalString(std::string &out, bool &hasValue)
+        {
+            out.clear();
+            if (readNull())
+            {
+                hasValue = false;
+                return true;
+            }
+            hasValue = true;
+            return readString(&out);
+        }
+
+        bool skipValue(int depth = 0)
+        {
+            if (depth > MAX_DEPTH)
+                return false;
+            skipWhitespace();
+            if (pos == end)
+                return false;
+            switch (*pos)
+            {
+            case '"':
+                return readString(nullptr);
+            case '{':
+            {
+                pos++;
+                if (consume('}'))
+                    return true;
+                do
+                {
+                    std::string_view key;
+                    if (!readKey(key) || !skipValue(depth + 1))
+                        return false;
+                } while (consume(','));
+                return consume('}');
+            }
+            case '[':
+            {
+                pos++;
+                if (consume(']'))
+                    return true;
+                do
+                {
+                    if (!skipValue(depth + 1))
+                        return false;
+                } while (consume(','));
+                return consume(']');
+            }
+            case 't':
+                return readLiteral("true");
+            case 'f':
+                return readLiteral("false");
+            case 'n':
+                return readLiteral("null");
+            default:
+                return readNumber();
+            }
+        }
+    };
+}
+
+void StreamDelta::clear()
+{
+    content.clear();
+    reasoningContent.clear();
+    finishReason.clear();
+    hasFinishReason = false;
+}
+
+void StreamDelta::parse(std::string_view json)
+{
+    clear();
+    if (!extract(json))
+    {
+        clear();
+        parseFull(json);
+    }
+}
+
+bool StreamDelta::extract(std::string_view json)
+{
+    // nlohmann keeps the last of duplicate keys; rather than undo what an
+    // earlier one set, a repeated key that matters goes to the full parser
+    bool seenChoices = false, seenFinishReason = false, seenDelta = false, seenContent = false, seenReasoning = false;
+    auto firstTime = [](bool &seen)
+    {
+        bool first = !seen;
+        seen = true;
+        return first;
+    };
+    DeltaScanner scanner(json);
+    if (!scanner.consume('{'))
+        return false;
+    if (scanner.consume('}'))
+        return scanner.atEnd();
+    do
+    {
+        std::string_view key;
+        if (!scanner.readKey(key))
+            return false;
+        if (key == "choices" && !firstTime(seenChoices))
+            return false;
+        if (key != "choices" || !scanner.peek('['))
+        {
+            // choices[0] of anything but an array or null is an error the
+            // full parser reports
+            if (key == "choices" && !scanner.peek('n'))
+                return false;
+            if (!scanner.skipValue())
+                return false;
+            continue;
+        }
+
+        scanner.consume('[');
+        if (scanner.consume(']'))
+            continue;
+        bool firstChoice = true;
+        do
+        {
+            if (!firstChoice || !scanner.peek('{'))
+            {
+                if (firstChoice && !scanner.peek('n'))
+                    return false;
+                if (!scanner.skipValue(1))
+                    return false;
+                firstChoice = false;
+                continue;
+            }
+            firstChoice = false;
+
+            scanner.consume('{');
+            if (scanner.consume('}'))
+                continue;
+            do
+            {
+                std::string_view choiceKey;
+                if (!scanner.readKey(choiceKey))
+                    return false;
+                if ((choiceKey == "finish_reason" && !firstTime(seenFinishReason)) ||
+                    (choiceKey == "delta" && !firstTime(seenDelta)))
+                    return false;
+                if (choiceKey == "finish_reason")
+                {
+                    if (!scanner.readOptionalString(finishReason, hasFinishReason))
+                        return false;
+                }
+                else if (choiceKey == "delta" && !scanner.peek('{') && !scanner.peek('n'))
+                    return false;
+                else if (choiceKey == "delta" && scanner.peek('{'))
+                {
+                    scanner.consume('{');
+                    if (scanner.consume('}'))
+                        continue;
+                    do
+                    {
+                        std::string_view deltaKey;
+                        if (!scanner.readKey(deltaKey))
+                            return false;
+                        if ((deltaKey == "content" && !firstTime(seenContent)) ||
+                            (deltaKey == "reasoning_content" && !firstTime(seenReasoning)))
+                            return false;
+                        bool hasValue;
+                        if (deltaKey == "content")
+                        {
+                            if (!scanner.readOptionalString(content, hasValue))
+                                return false;
+                        }
+                        else if (deltaKey == "reasoning_content")
+                        {
+                            if (!scanner.readOptionalString(reasoningContent, hasValue))
+                                return false;
+                        }
+                        else if (!scanner.skipValue(3))
+                            return false;
+                    } while (scanner.consume(','));
+                    if (!scanner.consume('}'))
+                        return false;
+                }
+                else if (!scanner.skipValue(2))
+                    return false;
+            } while (scanner.consume(','));
+            if (!scanner.consume('}'))
+                return false;
+        } while (scanner.consume(','));
+        if (!scanner.consume(']'))
+            return false;
+    } while (scanner.consume(','));
+    return scanner.consume('}') && scanner.atEnd();
+}
+
+void StreamDelta::parseFull(std::string_view json)
+{
+    nlohmann::json chunkJson = nlohmann::json::parse(json.begin(), json.end());
+    auto choice = chunkJson["choices"][0];
+    if (choice["finish_reason"].is_string())
+    {
+        finishReason = choice["finish_reason"];
+        hasFinishReason = true;
+    }
+    if (choice["delta"]["reasoning_content"].is_string())
+        reasoningContent = choice["delta"]["reasoning_content"];
+    if (choice["delta"]["content"].is_string())
+        content = choice["delta"]["content"];
+}
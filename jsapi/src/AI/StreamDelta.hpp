@@ -0,0 +1,42 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// The fields of one chat.completion.chunk that a streamed reply needs.
+// Kept alive across events so its strings reuse their capacity.
+class StreamDelta
+{
+private:
+    bool extract(std::string_view json);
+    void parseFull(std::string_view json);
+
+public:
+    std::string content;
+    std::string reasoningContent;
+    std::string finishReason;
+    bool hasFinishReason = false;
+
+    void clear();
+    // Scans the chunk for choices[0].delta and finish_reason without
+    // building a document; anything unexpected falls back to nlohmann, as
+    // does a repeated key among those, so the last of them wins either way
+    void parse(std::string_view json);
+};
@@ -0,0 +1,154 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "AsyncDatabase.hpp"
+#include <iostream>
+
+AsyncDatabase::AsyncDatabase(const std::string &filePath, size_t maxBatchSize, const DatabaseOptions &options)
+    : filePath(filePath), maxBatchSize(maxBatchSize), options(options)
+{
+    ASSERT(maxBatchSize > 0);
+    worker = std::thread(&AsyncDatabase::run, this);
+}
+AsyncDatabase::~AsyncDatabase()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        stopping = true;
+    }
+    jobsCondition.notify_one();
+    worker.join();
+}
+
+void AsyncDatabase::enqueue(Job job)
+{
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        ASSERT(!stopping);
+        if (openError)
+            error = openError;
+        else
+            jobs.push_back(std::move(job));
+    }
+    if (error)
+        job.settle(error);
+    else
+        jobsCondition.notify_one();
+}
+std::future<void> AsyncDatabase::flush()
+{
+    return read([](DATABASE &database)
+                { database.flush(); });
+}
+
+// Leaves the worker with nothing to run: the queued jobs fail now and later
+// ones as they are enqueued
+void AsyncDatabase::failAll(std::exception_ptr error)
+{
+    std::deque<Job> failed;
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        openError = error;
+        failed.swap(jobs);
+    }
+    for (auto &job : failed)
+        job.settle(error);
+}
+
+void AsyncDatabase::run()
+{
+    std::optional<DATABASE> opened;
+    try
+    {
+        opened.emplace(filePath, options);
+        if (!opened->isOpen())
+            THROW_EXCEPTION("cannot open the database file");
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failed to open " << filePath << ": " << e.what() << std::endl;
+        failAll(std::current_exception());
+        return;
+    }
+    DATABASE &database = *opened;
+    while (true)
+    {
+        std::vector<Job> batch;
+        {
+            std::unique_lock<std::mutex> lock(jobsMutex);
+            jobsCondition.wait(lock, [this]
+                               { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+            batch.push_back(std::move(jobs.front()));
+            jobs.pop_front();
+            while (batch.front().write && batch.size() < maxBatchSize && !jobs.empty() && jobs.front().write)
+            {
+                batch.push_back(std::move(jobs.front()));
+                jobs.pop_front();
+            }
+        }
+        if (batch.front().write)
+            runWrites(database, batch);
+        else
+        {
+            std::exception_ptr error;
+            try
+            {
+                batch.front().run(database);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            batch.front().settle(error);
+        }
+    }
+}
+void AsyncDatabase::runWrites(DATABASE &database, std::vector<Job> &batch)
+{
+    std::vector<std::exception_ptr> errors(batch.size());
+    try
+    {
+        TRANSACTION transaction = database.transaction();
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            TRANSACTION savepoint = database.savepoint("async_job");
+            try
+            {
+                batch[i].run(database);
+                savepoint.commit();
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        }
+        transaction.commit();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Async database batch failed: " << e.what() << std::endl;
+        for (auto &error : errors)
+            if (!error)
+                error = std::current_exception();
+    }
+    // Results are only published once the batch is durable
+    for (size_t i = 0; i < batch.size(); i++)
+        batch[i].settle(errors[i]);
+}
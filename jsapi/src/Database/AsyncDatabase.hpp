@@ -0,0 +1,122 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "Database.hpp"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+
+// Owns a DATABASE on a dedicated worker thread. Jobs are queued and answered
+// through futures, so callers never wait on disk unless they call get().
+// Consecutive write jobs are merged into one transaction, each job running
+// inside its own savepoint so a failing job does not discard its neighbours.
+class AsyncDatabase
+{
+private:
+    struct Job
+    {
+        bool write;
+        std::function<void(DATABASE &)> run;
+        std::function<void(std::exception_ptr)> settle;
+    };
+
+    template <typename R>
+    struct JobState
+    {
+        std::promise<R> promise;
+        std::optional<R> result;
+
+        template <typename F>
+        void run(F &job, DATABASE &database) { result.emplace(job(database)); }
+        void settle(std::exception_ptr error)
+        {
+            if (error)
+                promise.set_exception(error);
+            else
+                promise.set_value(std::move(*result));
+        }
+    };
+
+    std::string filePath;
+    size_t maxBatchSize;
+    DatabaseOptions options;
+
+    std::deque<Job> jobs;
+    std::mutex jobsMutex;
+    std::condition_variable jobsCondition;
+    bool stopping = false;
+    // Set when the database could not be opened; every job fails with it
+    std::exception_ptr openError;
+    std::thread worker;
+
+    void enqueue(Job job);
+    void run();
+    void failAll(std::exception_ptr error);
+    void runWrites(DATABASE &database, std::vector<Job> &batch);
+
+    template <typename F>
+    auto submit(bool write, F &&job)
+    {
+        using R = std::invoke_result_t<F, DATABASE &>;
+        auto state = std::make_shared<JobState<R>>();
+        auto future = state->promise.get_future();
+        enqueue({write,
+                 [state, job = std::forward<F>(job)](DATABASE &database) mutable
+                 { state->run(job, database); },
+                 [state](std::exception_ptr error)
+                 { state->settle(error); }});
+        return future;
+    }
+
+public:
+    AsyncDatabase(const std::string &filePath, size_t maxBatchSize = 64, const DatabaseOptions &options = DatabaseOptions{});
+    AsyncDatabase(const AsyncDatabase &) = delete;
+    AsyncDatabase &operator=(const AsyncDatabase &) = delete;
+    ~AsyncDatabase();
+
+    template <typename F>
+    auto read(F &&job) { return submit(false, std::forward<F>(job)); }
+    template <typename F>
+    auto write(F &&job) { return submit(true, std::forward<F>(job)); }
+    // Resolves once every job queued before it has run and, for an
+    // in-memory database, a snapshot has been written
+    std::future<void> flush();
+};
+
+template <>
+struct AsyncDatabase::JobState<void>
+{
+    std::promise<void> promise;
+
+    template <typename F>
+    void run(F &job, DATABASE &database) { job(database); }
+    void settle(std::exception_ptr error)
+    {
+        if (error)
+            promise.set_exception(error);
+        else
+            promise.set_value();
+    }
+};
@@ -0,0 +1,64 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "Blob.hpp"
+#include "Transaction.hpp"
+#include <algorithm>
+
+BLOB::BLOB(sqlite3 *conn, const std::string &tableName, const std::string &columnName, sqlite3_int64 rowId,
+           bool writable, ConnectionPool *readers)
+    : conn(conn), writable(writable)
+{
+    ASSERT(conn != nullptr);
+    if (readers && !writable && !TRANSACTION::isOpen(conn))
+    {
+        lease.emplace(readers->acquire());
+        this->conn = lease->get();
+    }
+    ASSERT_DATABASE_OK(sqlite3_blob_open(this->conn, "main", tableName.c_str(), columnName.c_str(),
+                                         rowId, writable ? 1 : 0, &handle));
+}
+BLOB::~BLOB()
+{
+    if (handle)
+        sqlite3_blob_close(handle);
+}
+
+size_t BLOB::size() const
+{
+    return sqlite3_blob_bytes(handle);
+}
+std::string BLOB::read(size_t offset, size_t length) const
+{
+    size_t total = size();
+    if (offset >= total)
+        return "";
+    length = std::min(length, total - offset);
+    std::string data(length, '\0');
+    ASSERT_DATABASE_OK(sqlite3_blob_read(handle, data.data(), length, offset));
+    return data;
+}
+void BLOB::write(size_t offset, const std::string &data)
+{
+    ASSERT(writable);
+    ASSERT(offset + data.size() <= size());
+    ASSERT_DATABASE_OK(sqlite3_blob_write(handle, data.data(), data.size(), offset));
+}
+void BLOB::reopen(sqlite3_int64 rowId)
+{
+    ASSERT_DATABASE_OK(sqlite3_blob_reopen(handle, rowId));
+}
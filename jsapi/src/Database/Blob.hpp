@@ -0,0 +1,49 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "Includes.hpp"
+#include "ConnectionPool.hpp"
+#include <optional>
+
+// Incremental I/O on a single BLOB or TEXT value. Ranges are read or
+// overwritten in place without materialising the whole value; the size of
+// the value is fixed, so callers preallocate with zeroblob() to append.
+// A read-only handle on a pooled database holds a reader for its lifetime.
+class BLOB
+{
+private:
+    std::optional<ConnectionPool::Lease> lease;
+    sqlite3 *conn;
+    sqlite3_blob *handle = nullptr;
+    bool writable;
+
+public:
+    BLOB(sqlite3 *conn, const std::string &tableName, const std::string &columnName, sqlite3_int64 rowId,
+         bool writable = false, ConnectionPool *readers = nullptr);
+    BLOB(const BLOB &) = delete;
+    BLOB &operator=(const BLOB &) = delete;
+    ~BLOB();
+
+    size_t size() const;
+    // Reads at most length bytes starting at offset; shorter near the end
+    std::string read(size_t offset, size_t length) const;
+    void write(size_t offset, const std::string &data);
+    // Moves the handle to another row of the same column
+    void reopen(sqlite3_int64 rowId);
+};
@@ -0,0 +1,81 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "Checkpointer.hpp"
+
+Checkpointer::Checkpointer(sqlite3 *writer, const std::string &filePath, size_t idleDelayMs, size_t maxPages)
+    : writer(writer), idleDelay(idleDelayMs), maxPages(maxPages)
+{
+    ASSERT(writer != nullptr);
+    if (sqlite3_open(filePath.c_str(), &conn) != SQLITE_OK)
+    {
+        if (conn)
+            sqlite3_close(conn);
+        conn = nullptr;
+        return;
+    }
+    sqlite3_busy_timeout(conn, 5000);
+    // Installing a WAL hook also disables SQLite's inline auto-checkpoint
+    sqlite3_wal_hook(writer, walHook, this);
+    worker = std::thread(&Checkpointer::run, this);
+}
+Checkpointer::~Checkpointer()
+{
+    if (!conn)
+        return;
+    sqlite3_wal_hook(writer, nullptr, nullptr);
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    stateCondition.notify_one();
+    worker.join();
+    sqlite3_close(conn);
+}
+
+int Checkpointer::walHook(void *self, sqlite3 *, const char *, int pages)
+{
+    Checkpointer *checkpointer = static_cast<Checkpointer *>(self);
+    {
+        std::lock_guard<std::mutex> lock(checkpointer->stateMutex);
+        checkpointer->pendingPages = pages;
+        checkpointer->lastCommit = std::chrono::steady_clock::now();
+    }
+    checkpointer->stateCondition.notify_one();
+    return SQLITE_OK;
+}
+
+void Checkpointer::run()
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    while (true)
+    {
+        stateCondition.wait(lock, [this]
+                            { return stopping || pendingPages > 0; });
+        while (!stopping && pendingPages < maxPages &&
+               std::chrono::steady_clock::now() - lastCommit < idleDelay)
+            stateCondition.wait_until(lock, lastCommit + idleDelay);
+        if (pendingPages == 0)
+            return;
+        pendingPages = 0;
+        lock.unlock();
+        sqlite3_wal_checkpoint_v2(conn, nullptr, SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr);
+        lock.lock();
+        if (stopping)
+            return;
+    }
+}
@@ -0,0 +1,53 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "Includes.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Takes WAL checkpoints off the commit path. The writer's WAL hook reports
+// each commit here, and a background connection runs a passive checkpoint
+// once no commit has arrived for idleDelay, or straight away when the log
+// grows beyond maxPages.
+class Checkpointer
+{
+private:
+    sqlite3 *writer;
+    sqlite3 *conn = nullptr;
+    std::chrono::milliseconds idleDelay;
+    int maxPages;
+
+    int pendingPages = 0;
+    std::chrono::steady_clock::time_point lastCommit;
+    bool stopping = false;
+    std::mutex stateMutex;
+    std::condition_variable stateCondition;
+    std::thread worker;
+
+    static int walHook(void *self, sqlite3 *, const char *, int pages);
+    void run();
+
+public:
+    Checkpointer(sqlite3 *writer, const std::string &filePath, size_t idleDelayMs, size_t maxPages);
+    Checkpointer(const Checkpointer &) = delete;
+    Checkpointer &operator=(const Checkpointer &) = delete;
+    ~Checkpointer();
+};
@@ -0,0 +1,331 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "ColumnCodec.hpp"
+#include "Blob.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    constexpr size_t HEADER_SIZE = 10;
+    constexpr uint32_t RAW_FRAME = 0x80000000u;
+    constexpr size_t MIN_MATCH = 4;
+    constexpr int HASH_BITS = 12;
+
+    void putU32(std::string &out, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+            out += static_cast<char>((value >> (i * 8)) & 0xFF);
+    }
+    uint32_t getU32(const unsigned char *data)
+    {
+        return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+    void putLength(std::string &out, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+            out += static_cast<char>(255);
+        out += static_cast<char>(length);
+    }
+
+    void compressFrame(const unsigned char *src, size_t size, std::string &out)
+    {
+        uint32_t table[1 << HASH_BITS];
+        std::fill(std::begin(table), std::end(table), UINT32_MAX);
+        size_t i = 0, anchor = 0;
+        auto emit = [&](size_t matchOffset, size_t matchLength)
+        {
+            size_t literals = i - anchor;
+            size_t extra = matchLength ? matchLength - MIN_MATCH : 0;
+            out += static_cast<char>((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(extra, 15));
+            if (literals >= 15)
+                putLength(out, literals - 15);
+            out.append(reinterpret_cast<const char *>(src + anchor), literals);
+            if (!matchLength)
+                return;
+            out += static_cast<char>(matchOffset & 0xFF);
+            out += static_cast<char>(matchOffset >> 8);
+            if (extra >= 15)
+                putLength(out, extra - 15);
+        };
+        while (i + MIN_MATCH <= size)
+        {
+            uint32_t sequence;
+            std::memcpy(&sequence, src + i, 4);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+            uint32_t candidate = table[hash];
+            table[hash] = i;
+            if (candidate == UINT32_MAX || i - candidate > 0xFFFF || std::memcmp(src + candidate, src + i, 4) != 0)
+            {
+                i++;
+                continue;
+            }
+            size_t length = MIN_MATCH;
+            while (i + length < size && src[candidate + length] == src[i + length])
+                length++;
+            emit(i - candidate, length);
+            i += length;
+            anchor = i;
+        }
+        i = size;
+        emit(0, 0);
+    }
+
+    bool decompressFrame(const unsigned char *src, size_t size, size_t rawSize, std::string &out)
+    {
+        size_t start = out.size(), ip = 0;
+        auto readLength = [&](size_t &length)
+        {
+            unsigned char byte;
+            do
+            {
+                if (ip >= size)
+                    return false;
+                byte = src[ip++];
+                length += byte;
+            } while (byte == 255);
+            return true;
+        };
+        while (ip < size)
+        {
+            unsigned char token = src[ip++];
+            size_t literals = token >> 4;
+            if (literals == 15 && !readLength(literals))
+                return false;
+            if (literals > size - ip || out.size() - start + literals > rawSize)
+                return false;
+            out.append(reinterpret_cast<const char *>(src + ip), literals);
+            ip += literals;
+            if (ip == size)
+                break;
+            if (size - ip < 2)
+                return false;
+            size_t offset = src[ip] | (src[ip + 1] << 8);
+            ip += 2;
+            size_t length = token & 0x0F;
+            if (length == 15 && !readLength(length))
+                return false;
+            length += MIN_MATCH;
+            if (offset == 0 || offset > out.size() - start || out.size() - start + length > rawSize)
+                return false;
+            size_t from = out.size() - offset;
+            if (offset >= length)
+                out.append(out, from, length);
+            else
+                // An overlapping match repeats its own output, so it is copied byte by byte
+                for (size_t k = 0; k < length; k++)
+                    out += out[from + k];
+        }
+        return out.size() - start == rawSize;
+    }
+
+    struct Header
+    {
+        size_t rawSize;
+        std::vector<uint32_t> frames;
+    };
+    bool parseHeader(const unsigned char *data, size_t size, Header &header)
+    {
+        if (size < HEADER_SIZE || data[0] != ColumnCodec::TAG || data[1] != ColumnCodec::VERSION)
+            return false;
+        header.rawSize = getU32(data + 2);
+        size_t count = getU32(data + 6);
+        if (count != (header.rawSize + ColumnCodec::FRAME_SIZE - 1) / ColumnCodec::FRAME_SIZE ||
+            count > (size - HEADER_SIZE) / 4)
+            return false;
+        header.frames.resize(count);
+        for (size_t i = 0; i < count; i++)
+            header.frames[i] = getU32(data + HEADER_SIZE + i * 4);
+        return true;
+    }
+    bool decodeFrame(const unsigned char *data, size_t size, uint32_t frame, size_t rawSize, std::string &out)
+    {
+        if (frame & RAW_FRAME)
+        {
+            if ((frame & ~RAW_FRAME) != size || size != rawSize)
+                return false;
+            out.append(reinterpret_cast<const char *>(data), size);
+            return true;
+        }
+        return decompressFrame(data, size, rawSize, out);
+    }
+
+    void decompressFunction(sqlite3_context *context, int, sqlite3_value **argv)
+    {
+        if (sqlite3_value_type(argv[0]) != SQLITE_BLOB)
+        {
+            sqlite3_result_value(context, argv[0]);
+            return;
+        }
+        const char *data = static_cast<const char *>(sqlite3_value_blob(argv[0]));
+        size_t size = sqlite3_value_bytes(argv[0]);
+        if (!ColumnCodec::isEncoded(data, size))
+        {
+            sqlite3_result_value(context, argv[0]);
+            return;
+        }
+        std::string value = ColumnCodec::decode(std::string(data, size));
+        sqlite3_result_text(context, value.data(), value.size(), SQLITE_TRANSIENT);
+    }
+}
+
+ColumnCodec &ColumnCodec::instance()
+{
+    static ColumnCodec codec;
+    return codec;
+}
+
+void ColumnCodec::registerColumn(sqlite3 *conn, const std::string &tableName, const std::string &columnName)
+{
+    std::lock_guard<std::mutex> lock(columnsMutex);
+    columns[conn][tableName].insert(columnName);
+}
+void ColumnCodec::unregisterConnection(sqlite3 *conn)
+{
+    std::lock_guard<std::mutex> lock(columnsMutex);
+    columns.erase(conn);
+}
+std::unordered_set<std::string> ColumnCodec::compressedColumns(sqlite3 *conn, const std::string &tableName)
+{
+    std::lock_guard<std::mutex> lock(columnsMutex);
+    auto connection = columns.find(conn);
+    if (connection == columns.end())
+        return {};
+    auto table = connection->second.find(tableName);
+    return table == connection->second.end() ? std::unordered_set<std::string>{} : table->second;
+}
+
+bool ColumnCodec::isEncoded(const char *data, size_t size)
+{
+    return size >= HEADER_SIZE && static_cast<unsigned char>(data[0]) == TAG &&
+           static_cast<unsigned char>(data[1]) == VERSION;
+}
+
+std::string ColumnCodec::encode(const std::string &value)
+{
+    if (value.size() < THRESHOLD || value.size() > UINT32_MAX / 2)
+        return value;
+    size_t count = (value.size() + FRAME_SIZE - 1) / FRAME_SIZE;
+    std::string encoded, frame;
+    encoded.reserve(value.size() / 2);
+    encoded += static_cast<char>(TAG);
+    encoded += static_cast<char>(VERSION);
+    putU32(encoded, value.size());
+    putU32(encoded, count);
+    encoded.append(count * 4, '\0');
+    const unsigned char *src = reinterpret_cast<const unsigned char *>(value.data());
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t offset = i * FRAME_SIZE, size = std::min(FRAME_SIZE, value.size() - offset);
+        frame.clear();
+        compressFrame(src + offset, size, frame);
+        uint32_t entry = frame.size();
+        if (frame.size() >= size)
+        {
+            entry = size | RAW_FRAME;
+            encoded.append(value, offset, size);
+        }
+        else
+            encoded += frame;
+        for (int b = 0; b < 4; b++)
+            encoded[HEADER_SIZE + i * 4 + b] = static_cast<char>((entry >> (b * 8)) & 0xFF);
+    }
+    return encoded.size() < value.size() ? encoded : value;
+}
+
+std::string ColumnCodec::decode(const std::string &value)
+{
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(value.data());
+    Header header;
+    if (!isEncoded(value.data(), value.size()) || !parseHeader(data, value.size(), header))
+        return value;
+    std::string decoded;
+    decoded.reserve(header.rawSize);
+    size_t position = HEADER_SIZE + header.frames.size() * 4;
+    for (size_t i = 0; i < header.frames.size(); i++)
+    {
+        size_t size = header.frames[i] & ~RAW_FRAME;
+        size_t rawSize = std::min(FRAME_SIZE, header.rawSize - i * FRAME_SIZE);
+        if (size > value.size() - position || !decodeFrame(data + position, size, header.frames[i], rawSize, decoded))
+            return value;
+        position += size;
+    }
+    return decoded;
+}
+
+std::string ColumnCodec::decodeRange(const BLOB &blob, size_t offset, size_t length, size_t &totalLength)
+{
+    std::string prefix = blob.read(0, HEADER_SIZE);
+    if (!isEncoded(prefix.data(), prefix.size()))
+    {
+        totalLength = blob.size();
+        return blob.read(offset, length);
+    }
+    size_t count = getU32(reinterpret_cast<const unsigned char *>(prefix.data()) + 6);
+    std::string head = blob.read(0, HEADER_SIZE + count * 4);
+    Header header;
+    ASSERT(parseHeader(reinterpret_cast<const unsigned char *>(head.data()), head.size(), header));
+    totalLength = header.rawSize;
+    if (offset >= header.rawSize || length == 0)
+        return "";
+    length = std::min(length, header.rawSize - offset);
+
+    // Only the frames overlapping [offset, offset + length) are read and decoded
+    size_t first = offset / FRAME_SIZE, last = (offset + length - 1) / FRAME_SIZE;
+    size_t position = head.size();
+    for (size_t i = 0; i < first; i++)
+        position += header.frames[i] & ~RAW_FRAME;
+    std::string decoded;
+    decoded.reserve((last - first + 1) * FRAME_SIZE);
+    for (size_t i = first; i <= last; i++)
+    {
+        size_t size = header.frames[i] & ~RAW_FRAME;
+        std::string frame = blob.read(position, size);
+        size_t rawSize = std::min(FRAME_SIZE, header.rawSize - i * FRAME_SIZE);
+        ASSERT(frame.size() == size);
+        ASSERT(decodeFrame(reinterpret_cast<const unsigned char *>(frame.data()), size, header.frames[i], rawSize, decoded));
+        position += size;
+    }
+    return decoded.substr(offset - first * FRAME_SIZE, length);
+}
+
+int ColumnCodec::bind(sqlite3_stmt *stmt, int idx, const std::string &value)
+{
+    if (isEncoded(value.data(), value.size()))
+        return sqlite3_bind_blob(stmt, idx, value.data(), value.size(), SQLITE_TRANSIENT);
+    return sqlite3_bind_text(stmt, idx, value.c_str(), -1, SQLITE_TRANSIENT);
+}
+
+std::string ColumnCodec::column(sqlite3_stmt *stmt, int idx, bool compressed)
+{
+    if (sqlite3_column_type(stmt, idx) == SQLITE_BLOB)
+    {
+        const char *data = static_cast<const char *>(sqlite3_column_blob(stmt, idx));
+        std::string value(data ? data : "", sqlite3_column_bytes(stmt, idx));
+        return compressed ? decode(value) : value;
+    }
+    const unsigned char *val = sqlite3_column_text(stmt, idx);
+    return val ? std::string(reinterpret_cast<const char *>(val), sqlite3_column_bytes(stmt, idx)) : "";
+}
+
+void ColumnCodec::registerFunctions(sqlite3 *conn)
+{
+    sqlite3_create_function(conn, "decompress", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+                            decompressFunction, nullptr, nullptr);
+}
@@ -0,0 +1,77 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <sqlite3/sqlite3.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+class BLOB;
+
+// Opt-in compression for large TEXT columns (TABLE::COMPRESSED).
+//
+// An encoded value is stored as a BLOB:
+//   0xFF 0x01 | u32 raw size | u32 frame count | u32 frame sizes... | frames
+// Each frame holds up to FRAME_SIZE raw bytes compressed with an LZ77 block
+// codec (LZ4 block layout); a frame whose size has the top bit set is stored
+// raw. 0xFF never starts UTF-8 text, so plain rows written before a column was
+// marked COMPRESSED, or values under the threshold, read back unchanged.
+// Only columns registered as compressed are decoded on the way out; other
+// BLOBs come back as stored whatever their first bytes. Independent frames
+// let a byte range be decoded without the whole value.
+class ColumnCodec
+{
+private:
+    std::mutex columnsMutex;
+    // Writer connection -> table -> its compressed columns
+    std::unordered_map<sqlite3 *, std::unordered_map<std::string, std::unordered_set<std::string>>> columns;
+
+    ColumnCodec() = default;
+
+public:
+    static constexpr unsigned char TAG = 0xFF;
+    static constexpr unsigned char VERSION = 0x01;
+    static constexpr size_t THRESHOLD = 256;
+    static constexpr size_t FRAME_SIZE = 16384;
+
+    static ColumnCodec &instance();
+
+    // Compressed columns are remembered per writer connection so INSERT and UPDATE encode them
+    void registerColumn(sqlite3 *conn, const std::string &tableName, const std::string &columnName);
+    void unregisterConnection(sqlite3 *conn);
+    // Looked up once per statement rather than per value
+    std::unordered_set<std::string> compressedColumns(sqlite3 *conn, const std::string &tableName);
+
+    static bool isEncoded(const char *data, size_t size);
+    // Returns the value unchanged when it is short or does not shrink
+    static std::string encode(const std::string &value);
+    // Returns the value unchanged when it is not encoded or fails to parse
+    static std::string decode(const std::string &value);
+    static std::string decodeRange(const BLOB &blob, size_t offset, size_t length, size_t &totalLength);
+
+    // Binds a value, as a BLOB when it is encoded
+    static int bind(sqlite3_stmt *stmt, int idx, const std::string &value);
+    // Reads a result column; the value of a compressed column is decoded
+    static std::string column(sqlite3_stmt *stmt, int idx, bool compressed = false);
+    // Adds decompress(x) to a connection for SQL that reads compressed
+    // columns; it is meant for those columns only
+    static void registerFunctions(sqlite3 *conn);
+};
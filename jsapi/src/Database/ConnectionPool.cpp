@@ -0,0 +1,61 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "ConnectionPool.hpp"
+
+ConnectionPool::ConnectionPool(const std::string &filePath, size_t size)
+{
+    ASSERT(size > 0);
+    for (size_t i = 0; i < size; i++)
+    {
+        sqlite3 *conn = nullptr;
+        if (sqlite3_open_v2(filePath.c_str(), &conn, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK)
+        {
+            if (conn)
+                sqlite3_close(conn);
+            continue;
+        }
+        sqlite3_busy_timeout(conn, 5000);
+        ColumnCodec::registerFunctions(conn);
+        connections.push_back(conn);
+    }
+    ASSERT(!connections.empty());
+    idle = connections;
+}
+ConnectionPool::~ConnectionPool()
+{
+    for (auto conn : connections)
+        sqlite3_close(conn);
+}
+
+ConnectionPool::Lease ConnectionPool::acquire()
+{
+    std::unique_lock<std::mutex> lock(idleMutex);
+    idleCondition.wait(lock, [this]
+                       { return !idle.empty(); });
+    sqlite3 *conn = idle.back();
+    idle.pop_back();
+    return Lease(this, conn);
+}
+void ConnectionPool::release(sqlite3 *conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        idle.push_back(conn);
+    }
+    idleCondition.notify_one();
+}
@@ -0,0 +1,63 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "Includes.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// A fixed set of read-only connections handed out one caller at a time.
+// Used alongside a WAL-mode writer so SELECTs never queue behind writes.
+class ConnectionPool
+{
+private:
+    std::vector<sqlite3 *> connections;
+    std::vector<sqlite3 *> idle;
+    std::mutex idleMutex;
+    std::condition_variable idleCondition;
+
+    void release(sqlite3 *conn);
+
+public:
+    class Lease
+    {
+    private:
+        ConnectionPool *pool;
+        sqlite3 *conn;
+
+    public:
+        Lease(ConnectionPool *pool, sqlite3 *conn) : pool(pool), conn(conn) {}
+        Lease(Lease &&other) noexcept : pool(other.pool), conn(other.conn) { other.conn = nullptr; }
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        ~Lease()
+        {
+            if (conn)
+                pool->release(conn);
+        }
+        sqlite3 *get() const { return conn; }
+    };
+
+    ConnectionPool(const std::string &filePath, size_t size);
+    ConnectionPool(const ConnectionPool &) = delete;
+    ConnectionPool &operator=(const ConnectionPool &) = delete;
+    ~ConnectionPool();
+
+    Lease acquire();
+};
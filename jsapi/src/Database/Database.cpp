@@ -17,20 +17,76 @@
 
 #include "Database.hpp"
 
-DATABASE::DATABASE(const std::string &filePath)
+DATABASE::DATABASE(const std::string &filePath, const DatabaseOptions &options)
 {
-    if (sqlite3_open(filePath.c_str(), &conn) != SQLITE_OK && conn)
+    ASSERT(!options.inMemory || options.readers == 0);
+    WriteCounter::install();
+    // An in-memory database is serialized: the Snapshotter copies it from its
+    // own thread under the connection's mutex, which only exists in that mode
+    int res = options.inMemory ? sqlite3_open_v2(":memory:", &conn,
+                                                 SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, nullptr)
+                               : sqlite3_open(filePath.c_str(), &conn);
+    if (res != SQLITE_OK && conn)
+    {
         sqlite3_close(conn);
+        conn = nullptr;
+    }
+    if (!conn)
+        return;
+    ColumnCodec::registerFunctions(conn);
+    try
+    {
+        if (options.readers > 0)
+        {
+            sqlite3_busy_timeout(conn, 5000);
+            ASSERT_DATABASE_OK(sqlite3_exec(conn, "PRAGMA journal_mode=WAL", nullptr, nullptr, nullptr));
+            ASSERT_DATABASE_OK(sqlite3_exec(conn, "PRAGMA synchronous=NORMAL", nullptr, nullptr, nullptr));
+            readers = std::make_unique<ConnectionPool>(filePath, options.readers);
+            checkpointer = std::make_unique<Checkpointer>(conn, filePath, options.checkpointIdleMs, options.checkpointMaxPages);
+        }
+        if (options.inMemory)
+            snapshotter = std::make_unique<Snapshotter>(conn, filePath, options.snapshotIntervalMs, options.snapshotIdleMs);
+    }
+    catch (...)
+    {
+        // The destructor does not run for a constructor that throws
+        snapshotter.reset();
+        checkpointer.reset();
+        readers.reset();
+        ColumnCodec::instance().unregisterConnection(conn);
+        sqlite3_close(conn);
+        throw;
+    }
 }
 DATABASE::~DATABASE()
 {
+    snapshotter.reset();
+    checkpointer.reset();
+    readers.reset();
     if (conn)
+    {
+        ColumnCodec::instance().unregisterConnection(conn);
         sqlite3_close(conn);
+    }
 }
 
 TABLE DATABASE::table(const std::string &tableName) { return TABLE(conn, tableName); }
-SELECT DATABASE::select(const std::string &tableName) { return SELECT(conn, tableName); }
+SELECT DATABASE::select(const std::string &tableName) { return SELECT(conn, tableName, readers.get()); }
 INSERT DATABASE::insert(const std::string &tableName) { return INSERT(conn, tableName); }
 DELETE DATABASE::remove(const std::string &tableName) { return DELETE(conn, tableName); }
 UPDATE DATABASE::update(const std::string &tableName) { return UPDATE(conn, tableName); }
-SIZE DATABASE::size(const std::string &tableName) { return SIZE(conn, tableName); }
+SIZE DATABASE::size(const std::string &tableName) { return SIZE(conn, tableName, readers.get()); }
+QUERY DATABASE::query(const std::string &sql) { return QUERY(conn, sql, readers.get()); }
+BLOB DATABASE::blob(const std::string &tableName, const std::string &columnName, sqlite3_int64 rowId, bool writable)
+{
+    return BLOB(conn, tableName, columnName, rowId, writable, readers.get());
+}
+TRANSACTION DATABASE::transaction() { return TRANSACTION(conn); }
+TRANSACTION DATABASE::savepoint(const std::string &name) { return TRANSACTION(conn, name); }
+
+bool DATABASE::isOpen() const { return conn != nullptr; }
+void DATABASE::flush()
+{
+    if (snapshotter)
+        snapshotter->flush();
+}
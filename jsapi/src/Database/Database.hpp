@@ -23,20 +23,62 @@
 #include <vector>
 #include <functional>
 #include <unordered_map>
+#include <memory>
 #include "Table.hpp"
 #include "Select.hpp"
 #include "Insert.hpp"
 #include "Delete.hpp"
 #include "Update.hpp"
 #include "Size.hpp"
+#include "Transaction.hpp"
+#include "Query.hpp"
+#include "Blob.hpp"
+#include "ConnectionPool.hpp"
+#include "Checkpointer.hpp"
+#include "Snapshotter.hpp"
+#include "WriteCounter.hpp"
+
+class DatabaseOptions
+{
+public:
+    size_t readers;
+    size_t checkpointIdleMs;
+    size_t checkpointMaxPages;
+    bool inMemory = false;
+    size_t snapshotIntervalMs = 0;
+    size_t snapshotIdleMs = 0;
+
+    // readers > 0 switches the file to WAL: SELECT and SIZE then run on a
+    // pool of read-only connections while everything else uses the writer.
+    DatabaseOptions(size_t readers = 0,
+                    size_t checkpointIdleMs = 2000,
+                    size_t checkpointMaxPages = 4000)
+        : readers(readers), checkpointIdleMs(checkpointIdleMs),
+          checkpointMaxPages(checkpointMaxPages) {}
+
+    // For loss-tolerant, write-heavy data: the database lives in memory and
+    // the file only holds snapshots (see Snapshotter). A crash loses at most
+    // snapshotIntervalMs of commits.
+    static DatabaseOptions memory(size_t snapshotIntervalMs = 5000, size_t snapshotIdleMs = 1000)
+    {
+        DatabaseOptions options;
+        options.inMemory = true;
+        options.snapshotIntervalMs = snapshotIntervalMs;
+        options.snapshotIdleMs = snapshotIdleMs;
+        return options;
+    }
+};
 
 class DATABASE
 {
 private:
     sqlite3 *conn;
+    std::unique_ptr<ConnectionPool> readers;
+    std::unique_ptr<Checkpointer> checkpointer;
+    std::unique_ptr<Snapshotter> snapshotter;
 
 public:
-    DATABASE(const std::string &filePath);
+    DATABASE(const std::string &filePath, const DatabaseOptions &options = DatabaseOptions{});
     ~DATABASE();
 
     TABLE table(const std::string &tableName);
@@ -45,4 +87,13 @@ public:
     DELETE remove(const std::string &tableName);
     UPDATE update(const std::string &tableName);
     SIZE size(const std::string &tableName);
+    QUERY query(const std::string &sql);
+    BLOB blob(const std::string &tableName, const std::string &columnName, sqlite3_int64 rowId, bool writable = false);
+    TRANSACTION transaction();
+    TRANSACTION savepoint(const std::string &name);
+
+    // False when the file could not be opened; nothing else may be called then
+    bool isOpen() const;
+    // Snapshots an in-memory database to its file now; does nothing otherwise
+    void flush();
 };
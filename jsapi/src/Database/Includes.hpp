@@ -19,6 +19,13 @@
 #include <string>
 #include <Exceptions/AssertFailed.hpp>
 #include <Exceptions/DatabaseError.hpp>
+#include "QueryStats.hpp"
+#include "ColumnCodec.hpp"
+
+// Where the databases live on the device; host builds point it elsewhere
+#ifndef DATABASE_DIR
+#define DATABASE_DIR "/userdisk/database/"
+#endif
 
 #define ASSERT_DATABASE_OK(expr)                    \
     do                                              \
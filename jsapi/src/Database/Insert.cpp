@@ -40,13 +40,19 @@ int64_t INSERT::execute() const
         query += "?, ";
     query.erase(query.end() - 2, query.end());
     query += ")";
+    QueryTimer timer(query);
     sqlite3_stmt *stmt = nullptr;
     ASSERT_DATABASE_OK(sqlite3_prepare_v2(conn, query.c_str(), -1, &stmt, nullptr));
-    int idx = 1;
-    for (auto &value : values)
-        ASSERT_DATABASE_OK(sqlite3_bind_text(stmt, idx++, value.c_str(), -1, SQLITE_TRANSIENT));
+    timer.prepared();
+    std::unordered_set<std::string> compressed = ColumnCodec::instance().compressedColumns(conn, tableName);
+    for (size_t i = 0; i < values.size(); i++)
+        if (compressed.count(columns[i]))
+            ASSERT_DATABASE_OK(ColumnCodec::bind(stmt, i + 1, ColumnCodec::encode(values[i])));
+        else
+            ASSERT_DATABASE_OK(sqlite3_bind_text(stmt, i + 1, values[i].c_str(), -1, SQLITE_TRANSIENT));
     ASSERT_DATABASE_OK(sqlite3_step(stmt));
     int64_t lastId = sqlite3_last_insert_rowid(conn);
     ASSERT_DATABASE_OK(sqlite3_finalize(stmt));
+    timer.finish(sqlite3_changes(conn));
     return lastId;
 }
@@ -0,0 +1,97 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "Query.hpp"
+#include "Transaction.hpp"
+#include <optional>
+
+QUERY::QUERY(sqlite3 *conn, std::string sql, ConnectionPool *readers) : conn(conn), readers(readers), sql(sql)
+{
+    ASSERT(conn != nullptr);
+    ASSERT(!sql.empty());
+}
+QUERY &QUERY::bind(std::string value)
+{
+    this->values.push_back({VALUE::TEXT, std::move(value)});
+    return *this;
+}
+void QUERY::forEach(const std::function<bool(const std::unordered_map<std::string, std::string> &row)> &callback) const
+{
+    std::optional<ConnectionPool::Lease> lease;
+    sqlite3 *conn = this->conn;
+    QueryTimer timer(sql);
+    sqlite3_stmt *stmt = nullptr;
+    if (readers && !TRANSACTION::isOpen(conn))
+    {
+        lease.emplace(readers->acquire());
+        if (sqlite3_prepare_v2(lease->get(), sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK && sqlite3_stmt_readonly(stmt))
+            conn = lease->get();
+        else
+        {
+            sqlite3_finalize(stmt);
+            stmt = nullptr;
+            lease.reset();
+        }
+    }
+    if (!stmt)
+        ASSERT_DATABASE_OK(sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, nullptr));
+    timer.prepared();
+    int idx = 1;
+    for (const auto &value : values)
+    {
+        if (value.type == VALUE::TEXT)
+            ASSERT_DATABASE_OK(sqlite3_bind_text(stmt, idx, value.text.c_str(), -1, SQLITE_TRANSIENT));
+        else if (value.type == VALUE::INTEGER)
+            ASSERT_DATABASE_OK(sqlite3_bind_int64(stmt, idx, value.integer));
+        else
+            ASSERT_DATABASE_OK(sqlite3_bind_double(stmt, idx, value.real));
+        idx++;
+    }
+    uint64_t rows = 0;
+    int colCount = sqlite3_column_count(stmt);
+    int res;
+    while ((res = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        std::unordered_map<std::string, std::string> Row;
+        for (int i = 0; i < colCount; ++i)
+            Row[sqlite3_column_name(stmt, i)] = ColumnCodec::column(stmt, i);
+        rows++;
+        if (!callback(Row))
+        {
+            res = SQLITE_DONE;
+            break;
+        }
+    }
+    if (res != SQLITE_DONE)
+    {
+        DatabaseError error(__FILE__, __LINE__, conn);
+        sqlite3_finalize(stmt);
+        throw error;
+    }
+    ASSERT_DATABASE_OK(sqlite3_finalize(stmt));
+    timer.finish(colCount ? rows : sqlite3_changes(conn));
+}
+std::vector<std::unordered_map<std::string, std::string>> QUERY::execute() const
+{
+    std::vector<std::unordered_map<std::string, std::string>> Data;
+    forEach([&Data](const std::unordered_map<std::string, std::string> &row)
+            {
+                Data.push_back(row);
+                return true;
+            });
+    return Data;
+}
@@ -0,0 +1,69 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "Includes.hpp"
+#include "ConnectionPool.hpp"
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+// A hand-written statement for what the other builders cannot express
+// (joins, MATCH, DDL). Read-only statements run on the reader pool when
+// one is available. Results come back as stored: compressed columns are
+// read through decompress() in the SQL.
+class QUERY
+{
+private:
+    sqlite3 *conn;
+    ConnectionPool *readers;
+    std::string sql;
+    // Numbers keep their type, so they compare as numbers even against
+    // columns without affinity (FTS5 columns, for one)
+    struct VALUE
+    {
+        enum TYPE
+        {
+            TEXT,
+            INTEGER,
+            REAL
+        } type;
+        std::string text;
+        sqlite3_int64 integer = 0;
+        double real = 0;
+    };
+    std::vector<VALUE> values;
+
+public:
+    QUERY(sqlite3 *conn, std::string sql, ConnectionPool *readers = nullptr);
+    [[nodiscard]] QUERY &bind(std::string value);
+    template <typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+    [[nodiscard]] QUERY &bind(T data)
+    {
+        VALUE value{std::is_floating_point_v<T> ? VALUE::REAL : VALUE::INTEGER};
+        if constexpr (std::is_floating_point_v<T>)
+            value.real = data;
+        else
+            value.integer = data;
+        values.push_back(std::move(value));
+        return *this;
+    }
+    // Steps rows one at a time; returning false from the callback stops early
+    void forEach(const std::function<bool(const std::unordered_map<std::string, std::string> &row)> &callback) const;
+    std::vector<std::unordered_map<std::string, std::string>> execute() const;
+};
@@ -0,0 +1,116 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "QueryStats.hpp"
+
+QueryStats &QueryStats::instance()
+{
+    static QueryStats queryStats;
+    return queryStats;
+}
+
+void QueryStats::setEnabled(bool enabled)
+{
+    this->enabled.store(enabled, std::memory_order_relaxed);
+}
+void QueryStats::setSlowQueryLog(uint64_t thresholdUs, size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    slowQueryThresholdUs = thresholdUs;
+    slowQueryCapacity = capacity;
+    slowQueryNext = 0;
+    slowQueries.clear();
+    slowQueries.reserve(capacity);
+}
+
+void QueryStats::record(const std::string &sql, uint64_t rows, uint64_t prepareUs, uint64_t stepUs)
+{
+    uint64_t durationUs = prepareUs + stepUs;
+    std::lock_guard<std::mutex> lock(statsMutex);
+    auto it = stats.find(sql);
+    if (it == stats.end())
+    {
+        it = stats.emplace(sql, QueryStat{}).first;
+        it->second.sql = sql;
+    }
+    QueryStat &stat = it->second;
+    stat.calls++;
+    stat.rows += rows;
+    stat.totalUs += durationUs;
+    stat.prepareUs += prepareUs;
+    stat.stepUs += stepUs;
+    if (durationUs > stat.maxUs)
+        stat.maxUs = durationUs;
+
+    if (slowQueryCapacity == 0 || durationUs < slowQueryThresholdUs)
+        return;
+    SlowQuery slowQuery{sql, durationUs,
+                        std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count()};
+    if (slowQueries.size() < slowQueryCapacity)
+        slowQueries.push_back(std::move(slowQuery));
+    else
+        slowQueries[slowQueryNext] = std::move(slowQuery);
+    slowQueryNext = (slowQueryNext + 1) % slowQueryCapacity;
+}
+std::vector<QueryStat> QueryStats::getStats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    std::vector<QueryStat> result;
+    result.reserve(stats.size());
+    for (const auto &pair : stats)
+        result.push_back(pair.second);
+    return result;
+}
+std::vector<SlowQuery> QueryStats::getSlowQueries() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    if (slowQueries.size() < slowQueryCapacity)
+        return slowQueries;
+    std::vector<SlowQuery> result(slowQueries.begin() + slowQueryNext, slowQueries.end());
+    result.insert(result.end(), slowQueries.begin(), slowQueries.begin() + slowQueryNext);
+    return result;
+}
+void QueryStats::reset()
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    stats.clear();
+    slowQueries.clear();
+    slowQueryNext = 0;
+}
+
+QueryTimer::QueryTimer(const std::string &sql) : sql(sql), enabled(QueryStats::instance().isEnabled())
+{
+    if (enabled)
+        start = prepareEnd = clock::now();
+}
+void QueryTimer::prepared()
+{
+    if (enabled)
+        prepareEnd = clock::now();
+}
+void QueryTimer::finish(uint64_t rows)
+{
+    if (!enabled)
+        return;
+    auto end = clock::now();
+    QueryStats::instance().record(
+        sql, rows,
+        std::chrono::duration_cast<std::chrono::microseconds>(prepareEnd - start).count(),
+        std::chrono::duration_cast<std::chrono::microseconds>(end - prepareEnd).count());
+}
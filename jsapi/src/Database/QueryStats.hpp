@@ -0,0 +1,88 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct QueryStat
+{
+    std::string sql;
+    uint64_t calls = 0;
+    uint64_t rows = 0;
+    uint64_t totalUs = 0;
+    uint64_t maxUs = 0;
+    uint64_t prepareUs = 0;
+    uint64_t stepUs = 0;
+};
+
+struct SlowQuery
+{
+    std::string sql;
+    uint64_t durationUs;
+    int64_t timestamp;
+};
+
+// Process-wide counters keyed by SQL text. The builders bind every value as
+// a parameter, so the text already is the statement's shape.
+class QueryStats
+{
+private:
+    std::atomic<bool> enabled{true};
+    mutable std::mutex statsMutex;
+    std::unordered_map<std::string, QueryStat> stats;
+
+    uint64_t slowQueryThresholdUs = 0;
+    size_t slowQueryCapacity = 0;
+    size_t slowQueryNext = 0;
+    std::vector<SlowQuery> slowQueries;
+
+    QueryStats() = default;
+
+public:
+    static QueryStats &instance();
+
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+    void setSlowQueryLog(uint64_t thresholdUs, size_t capacity);
+
+    void record(const std::string &sql, uint64_t rows, uint64_t prepareUs, uint64_t stepUs);
+    std::vector<QueryStat> getStats() const;
+    std::vector<SlowQuery> getSlowQueries() const;
+    void reset();
+};
+
+class QueryTimer
+{
+private:
+    using clock = std::chrono::steady_clock;
+
+    const std::string &sql;
+    bool enabled;
+    clock::time_point start, prepareEnd;
+
+public:
+    QueryTimer(const std::string &sql);
+    void prepared();
+    void finish(uint64_t rows);
+};
@@ -16,9 +16,12 @@
 // along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "Select.hpp"
+#include "Transaction.hpp"
 #include <stdexcept>
+#include <optional>
 
-SELECT::SELECT(sqlite3 *conn, std::string tableName) : conn(conn), tableName(tableName)
+SELECT::SELECT(sqlite3 *conn, std::string tableName, ConnectionPool *readers)
+    : conn(conn), readers(readers), tableName(tableName)
 {
     ASSERT(conn != nullptr);
     ASSERT(!tableName.empty());
@@ -79,29 +82,48 @@ std::vector<std::unordered_map<std::string, std::string>> SELECT::execute() cons
             query += "\"" + Order.first + "\" " + (Order.second ? "ASC" : "DESC") + ", ";
         query.erase(query.end() - 2, query.end());
     }
+    // Bound like the conditions, so every page shares one statement in QueryStats
     if (limits)
-        query += " LIMIT " + std::to_string(limits);
+        query += " LIMIT ?";
     if (offsets)
-        query += " OFFSET " + std::to_string(offsets);
+        query += " OFFSET ?";
 
+    std::optional<ConnectionPool::Lease> lease;
+    sqlite3 *conn = this->conn;
+    if (readers && !TRANSACTION::isOpen(conn))
+    {
+        lease.emplace(readers->acquire());
+        conn = lease->get();
+    }
+    QueryTimer timer(query);
     sqlite3_stmt *stmt = nullptr;
     ASSERT_DATABASE_OK(sqlite3_prepare_v2(conn, query.c_str(), -1, &stmt, nullptr));
+    timer.prepared();
     int idx = 1;
     for (auto &condition : conditions)
         ASSERT_DATABASE_OK(sqlite3_bind_text(stmt, idx++, condition.second.c_str(), -1, SQLITE_TRANSIENT));
+    if (limits)
+        ASSERT_DATABASE_OK(sqlite3_bind_int64(stmt, idx++, (sqlite3_int64)limits));
+    if (offsets)
+        ASSERT_DATABASE_OK(sqlite3_bind_int64(stmt, idx++, (sqlite3_int64)offsets));
     std::vector<std::unordered_map<std::string, std::string>> Data;
     int colCount = columns.empty() ? sqlite3_column_count(stmt) : columns.size();
+    std::vector<std::string> colNames;
+    std::vector<bool> decode;
+    std::unordered_set<std::string> compressed = ColumnCodec::instance().compressedColumns(this->conn, tableName);
+    for (int i = 0; i < colCount; ++i)
+    {
+        colNames.push_back(columns.empty() ? sqlite3_column_name(stmt, i) : columns[i]);
+        decode.push_back(compressed.count(colNames.back()) > 0);
+    }
     while (sqlite3_step(stmt) == SQLITE_ROW)
     {
         std::unordered_map<std::string, std::string> Row;
         for (int i = 0; i < colCount; ++i)
-        {
-            std::string colName = columns.empty() ? sqlite3_column_name(stmt, i) : columns[i];
-            const unsigned char *val = sqlite3_column_text(stmt, i);
-            Row[colName] = val ? std::string(reinterpret_cast<const char *>(val)) : "";
-        }
+            Row[colNames[i]] = ColumnCodec::column(stmt, i, decode[i]);
         Data.push_back(Row);
     }
     ASSERT_DATABASE_OK(sqlite3_finalize(stmt));
+    timer.finish(Data.size());
     return Data;
 }
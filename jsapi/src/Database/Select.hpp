@@ -18,6 +18,7 @@
 #pragma once
 
 #include "Includes.hpp"
+#include "ConnectionPool.hpp"
 #include <vector>
 #include <functional>
 #include <unordered_map>
@@ -26,6 +27,7 @@ class SELECT
 {
 private:
     sqlite3 *conn;
+    ConnectionPool *readers;
     std::string tableName;
     std::vector<std::string> columns;
     std::vector<std::pair<std::string, std::string>> conditions;
@@ -34,7 +36,7 @@ private:
     size_t offsets = 0;
 
 public:
-    SELECT(sqlite3 *conn, std::string tableName);
+    SELECT(sqlite3 *conn, std::string tableName, ConnectionPool *readers = nullptr);
     [[nodiscard]] SELECT &select(std::string column);
     [[nodiscard]] SELECT &where(std::string column, std::string value);
     template <typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
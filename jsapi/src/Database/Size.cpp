@@ -16,9 +16,12 @@
 // along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "Size.hpp"
+#include "Transaction.hpp"
 #include <stdexcept>
+#include <optional>
 
-SIZE::SIZE(sqlite3 *conn, std::string tableName) : conn(conn), tableName(tableName)
+SIZE::SIZE(sqlite3 *conn, std::string tableName, ConnectionPool *readers)
+    : conn(conn), readers(readers), tableName(tableName)
 {
     ASSERT(conn != nullptr);
     ASSERT(!tableName.empty());
@@ -26,10 +29,21 @@ SIZE::SIZE(sqlite3 *conn, std::string tableName) : conn(conn), tableName(tableNa
 int SIZE::execute() const
 {
     std::string query = "SELECT COUNT(*) FROM \"" + tableName + "\"";
+    std::optional<ConnectionPool::Lease> lease;
+    sqlite3 *conn = this->conn;
+    if (readers && !TRANSACTION::isOpen(conn))
+    {
+        lease.emplace(readers->acquire());
+        conn = lease->get();
+    }
+    QueryTimer timer(query);
     sqlite3_stmt *stmt = nullptr;
     ASSERT_DATABASE_OK(sqlite3_prepare_v2(conn, query.c_str(), -1, &stmt, nullptr));
-    ASSERT_DATABASE_OK(sqlite3_step(stmt));
+    timer.prepared();
+    if (sqlite3_step(stmt) != SQLITE_ROW)
+        THROW_DATABASE_ERROR(conn);
     int count = sqlite3_column_int(stmt, 0);
     ASSERT_DATABASE_OK(sqlite3_finalize(stmt));
+    timer.finish(1);
     return count;
 }
@@ -18,15 +18,17 @@
 #pragma once
 
 #include "Includes.hpp"
+#include "ConnectionPool.hpp"
 #include <functional>
 
 class SIZE
 {
 private:
     sqlite3 *conn;
+    ConnectionPool *readers;
     std::string tableName;
 
 public:
-    [[nodiscard]] SIZE(sqlite3 *conn, std::string tableName);
+    [[nodiscard]] SIZE(sqlite3 *conn, std::string tableName, ConnectionPool *readers = nullptr);
     [[nodiscard]] int execute() const;
 };
@@ -0,0 +1,160 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "Snapshotter.hpp"
+
+Snapshotter::Snapshotter(sqlite3 *source, const std::string &filePath, size_t intervalMs, size_t idleDelayMs)
+    : source(source), interval(intervalMs), idleDelay(idleDelayMs)
+{
+    ASSERT(source != nullptr);
+    // snapshot() holds this mutex against the connection's other users
+    ASSERT(sqlite3_db_mutex(source) != nullptr);
+    ASSERT(intervalMs > 0);
+    if (sqlite3_open(filePath.c_str(), &conn) != SQLITE_OK || sqlite3_open(":memory:", &staging) != SQLITE_OK)
+    {
+        DatabaseError error(__FILE__, __LINE__, conn);
+        sqlite3_close(staging);
+        sqlite3_close(conn);
+        throw error;
+    }
+    sqlite3_busy_timeout(conn, 5000);
+    // Contents are loss-tolerant by choice of this mode: an unreadable
+    // snapshot starts the database empty and is replaced by the next one.
+    // The restore uses its own connection so the file connection is only
+    // ever locked after the staging one.
+    sqlite3 *snapshotFile = nullptr;
+    if (sqlite3_open_v2(filePath.c_str(), &snapshotFile, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK)
+        copy(source, snapshotFile);
+    sqlite3_close(snapshotFile);
+    sqlite3_commit_hook(source, commitHook, this);
+    worker = std::thread(&Snapshotter::run, this);
+}
+Snapshotter::~Snapshotter()
+{
+    if (worker.joinable())
+    {
+        sqlite3_commit_hook(source, nullptr, nullptr);
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            stopping = true;
+        }
+        stateCondition.notify_one();
+        worker.join();
+        if (dirty)
+            snapshot();
+    }
+    if (staging)
+        sqlite3_close(staging);
+    if (conn)
+        sqlite3_close(conn);
+}
+
+int Snapshotter::commitHook(void *self)
+{
+    Snapshotter *snapshotter = static_cast<Snapshotter *>(self);
+    {
+        std::lock_guard<std::mutex> lock(snapshotter->stateMutex);
+        auto now = std::chrono::steady_clock::now();
+        if (!snapshotter->dirty)
+            snapshotter->firstChange = now;
+        snapshotter->dirty = true;
+        snapshotter->lastChange = now;
+    }
+    snapshotter->stateCondition.notify_one();
+    return 0;
+}
+
+int Snapshotter::copy(sqlite3 *to, sqlite3 *from)
+{
+    sqlite3_backup *backup = sqlite3_backup_init(to, "main", from, "main");
+    if (!backup)
+        return sqlite3_errcode(to);
+    int res;
+    while ((res = sqlite3_backup_step(backup, -1)) == SQLITE_BUSY || res == SQLITE_LOCKED)
+        sqlite3_sleep(5);
+    sqlite3_backup_finish(backup);
+    return res == SQLITE_DONE ? SQLITE_OK : sqlite3_errcode(to);
+}
+
+int Snapshotter::snapshot()
+{
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    // The source is copied to a staging database under its own mutex, which is
+    // fast and sees only committed state. The slow write to flash then runs
+    // from the staging copy without blocking the source's users.
+    sqlite3_mutex *sourceMutex = sqlite3_db_mutex(source);
+    sqlite3_mutex_enter(sourceMutex);
+    if (!sqlite3_get_autocommit(source))
+    {
+        sqlite3_mutex_leave(sourceMutex);
+        return SQLITE_BUSY;
+    }
+    int res = copy(staging, source);
+    sqlite3_mutex_leave(sourceMutex);
+    if (res != SQLITE_OK)
+        return res;
+    return copy(conn, staging);
+}
+
+void Snapshotter::flush()
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        dirty = false;
+    }
+    int res = snapshot();
+    if (res != SQLITE_OK)
+    {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            dirty = true;
+        }
+        ASSERT(res != SQLITE_BUSY);
+        THROW_DATABASE_ERROR(conn);
+    }
+}
+
+void Snapshotter::run()
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    while (true)
+    {
+        stateCondition.wait(lock, [this]
+                            { return stopping || dirty; });
+        while (!stopping && dirty)
+        {
+            auto deadline = std::min(lastChange + idleDelay, firstChange + interval);
+            if (std::chrono::steady_clock::now() >= deadline)
+                break;
+            stateCondition.wait_until(lock, deadline);
+        }
+        if (stopping)
+            return;
+        if (!dirty)
+            continue;
+        dirty = false;
+        lock.unlock();
+        int res = snapshot();
+        lock.lock();
+        if (res != SQLITE_OK && !dirty)
+        {
+            // A transaction was open or the file failed: retry after another idle period
+            dirty = true;
+            firstChange = lastChange = std::chrono::steady_clock::now();
+        }
+    }
+}
@@ -0,0 +1,63 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "Includes.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Persists an in-memory database to its file with the online backup API.
+// The memory database is restored from the file on construction. After
+// that, every commit marks it dirty, and a background thread writes a
+// snapshot once no commit has arrived for idleDelay, or once the oldest
+// unsaved commit is interval old. A crash therefore loses at most interval
+// worth of commits. The destructor writes a final snapshot. The source
+// connection has to be serialized (SQLITE_OPEN_FULLMUTEX) so a snapshot
+// can lock out its other users.
+class Snapshotter
+{
+private:
+    sqlite3 *source;
+    sqlite3 *staging = nullptr;
+    sqlite3 *conn = nullptr;
+    std::chrono::milliseconds interval, idleDelay;
+
+    bool dirty = false;
+    std::chrono::steady_clock::time_point firstChange, lastChange;
+    bool stopping = false;
+    std::mutex stateMutex;
+    std::condition_variable stateCondition;
+    std::mutex snapshotMutex;
+    std::thread worker;
+
+    static int commitHook(void *self);
+    static int copy(sqlite3 *to, sqlite3 *from);
+    int snapshot();
+    void run();
+
+public:
+    Snapshotter(sqlite3 *source, const std::string &filePath, size_t intervalMs, size_t idleDelayMs);
+    Snapshotter(const Snapshotter &) = delete;
+    Snapshotter &operator=(const Snapshotter &) = delete;
+    ~Snapshotter();
+
+    // Writes a snapshot now; must not be called inside a transaction
+    void flush();
+};
@@ -17,6 +17,7 @@
 
 #include "Table.hpp"
 #include <stdexcept>
+#include <unordered_set>
 
 TABLE::TABLE(sqlite3 *conn, std::string tableName) : conn(conn), tableName(tableName)
 {
@@ -56,7 +57,19 @@ TABLE &TABLE::column(std::string name, ColumnType type, int options, std::string
     if (options & DEFAULT)
         columnDefinition += " DEFAULT '" + std::string(defaultValue) + "'";
 
-    columns.push_back(columnDefinition);
+    if (options & COMPRESSED)
+    {
+        ASSERT(type == TEXT || type == BLOB);
+        compressedColumns.push_back(name);
+    }
+
+    columns.push_back({name, columnDefinition});
+    return *this;
+}
+TABLE &TABLE::index(std::vector<std::string> columns)
+{
+    ASSERT(!columns.empty());
+    indexes.push_back(columns);
     return *this;
 }
 
@@ -65,11 +78,42 @@ void TABLE::execute() const
     std::string sql = "CREATE TABLE IF NOT EXISTS " + std::string(tableName) + " (";
     for (size_t i = 0; i < columns.size(); ++i)
     {
-        sql += columns[i];
+        sql += columns[i].second;
         if (i < columns.size() - 1)
             sql += ", ";
     }
     sql += ")";
 
     ASSERT_DATABASE_OK(sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, nullptr));
+
+    // Columns added to an existing table are appended, so older databases pick them up
+    std::unordered_set<std::string> existingColumns;
+    sqlite3_stmt *stmt = nullptr;
+    std::string pragma = "PRAGMA table_info(\"" + tableName + "\")";
+    ASSERT_DATABASE_OK(sqlite3_prepare_v2(conn, pragma.c_str(), -1, &stmt, nullptr));
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        existingColumns.insert(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)));
+    ASSERT_DATABASE_OK(sqlite3_finalize(stmt));
+    for (const auto &column : columns)
+        if (!existingColumns.count(column.first))
+        {
+            std::string alter = "ALTER TABLE " + tableName + " ADD COLUMN " + column.second;
+            ASSERT_DATABASE_OK(sqlite3_exec(conn, alter.c_str(), nullptr, nullptr, nullptr));
+        }
+
+    for (const auto &index : indexes)
+    {
+        std::string indexName = tableName, indexColumns;
+        for (const auto &column : index)
+        {
+            indexName += "_" + column;
+            indexColumns += "\"" + column + "\", ";
+        }
+        indexColumns.erase(indexColumns.end() - 2, indexColumns.end());
+        std::string create = "CREATE INDEX IF NOT EXISTS \"" + indexName + "_index\" ON \"" + tableName + "\" (" + indexColumns + ")";
+        ASSERT_DATABASE_OK(sqlite3_exec(conn, create.c_str(), nullptr, nullptr, nullptr));
+    }
+
+    for (const auto &column : compressedColumns)
+        ColumnCodec::instance().registerColumn(conn, tableName, column);
 }
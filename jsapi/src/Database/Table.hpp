@@ -28,7 +28,9 @@ class TABLE
 private:
     sqlite3 *conn;
     std::string tableName;
-    std::vector<std::string> columns;
+    std::vector<std::pair<std::string, std::string>> columns;
+    std::vector<std::vector<std::string>> indexes;
+    std::vector<std::string> compressedColumns;
 
 public:
     enum ColumnType
@@ -44,10 +46,13 @@ public:
         NOT_NULL = 1 << 1,
         UNIQUE = 1 << 2,
         AUTOINCREMENT = 1 << 3,
-        DEFAULT = 1 << 4
+        DEFAULT = 1 << 4,
+        // Values from ColumnCodec::THRESHOLD bytes up are stored compressed; see ColumnCodec
+        COMPRESSED = 1 << 5
     };
 
     TABLE(sqlite3 *conn, std::string tableName);
     [[nodiscard]] TABLE &column(std::string name, ColumnType type = TEXT, int options = 0, std::string defaultValue = "");
+    [[nodiscard]] TABLE &index(std::vector<std::string> columns);
     void execute() const;
 };
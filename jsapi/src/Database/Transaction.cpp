@@ -0,0 +1,65 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "Transaction.hpp"
+#include <unordered_map>
+
+// Transactions and savepoints each thread has open, per connection
+static thread_local std::unordered_map<sqlite3 *, size_t> openTransactions;
+
+TRANSACTION::TRANSACTION(sqlite3 *conn, std::string savepoint) : conn(conn), savepoint(savepoint)
+{
+    ASSERT(conn != nullptr);
+    std::string query = savepoint.empty() ? "BEGIN IMMEDIATE" : "SAVEPOINT \"" + savepoint + "\"";
+    ASSERT_DATABASE_OK(sqlite3_exec(conn, query.c_str(), nullptr, nullptr, nullptr));
+    openTransactions[conn]++;
+}
+TRANSACTION::~TRANSACTION()
+{
+    if (finished)
+        return;
+    if (--openTransactions[conn] == 0)
+        openTransactions.erase(conn);
+    // Destructors must not throw, so an abandoned transaction is rolled back silently
+    if (savepoint.empty())
+        sqlite3_exec(conn, "ROLLBACK", nullptr, nullptr, nullptr);
+    else
+    {
+        std::string query = "ROLLBACK TO \"" + savepoint + "\"; RELEASE \"" + savepoint + "\"";
+        sqlite3_exec(conn, query.c_str(), nullptr, nullptr, nullptr);
+    }
+}
+void TRANSACTION::end(const std::string &query)
+{
+    ASSERT(!finished);
+    ASSERT_DATABASE_OK(sqlite3_exec(conn, query.c_str(), nullptr, nullptr, nullptr));
+    finished = true;
+    if (--openTransactions[conn] == 0)
+        openTransactions.erase(conn);
+}
+void TRANSACTION::commit()
+{
+    end(savepoint.empty() ? "COMMIT" : "RELEASE \"" + savepoint + "\"");
+}
+void TRANSACTION::rollback()
+{
+    end(savepoint.empty() ? "ROLLBACK" : "ROLLBACK TO \"" + savepoint + "\"; RELEASE \"" + savepoint + "\"");
+}
+bool TRANSACTION::isOpen(sqlite3 *conn)
+{
+    return openTransactions.count(conn) && !sqlite3_get_autocommit(conn);
+}
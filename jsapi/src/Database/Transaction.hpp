@@ -0,0 +1,42 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "Includes.hpp"
+
+class TRANSACTION
+{
+private:
+    sqlite3 *conn;
+    std::string savepoint;
+    bool finished = false;
+
+    void end(const std::string &query);
+
+public:
+    TRANSACTION(sqlite3 *conn, std::string savepoint = "");
+    TRANSACTION(const TRANSACTION &) = delete;
+    TRANSACTION &operator=(const TRANSACTION &) = delete;
+    ~TRANSACTION();
+    void commit();
+    void rollback();
+
+    // Whether the calling thread has a transaction open on conn. Its reads
+    // then have to run on conn too, as pooled readers would not see its writes.
+    static bool isOpen(sqlite3 *conn);
+};
@@ -47,13 +47,20 @@ void UPDATE::execute() const
             query += "\"" + condition.first + "\"=? AND ";
         query.erase(query.end() - 5, query.end());
     }
+    QueryTimer timer(query);
     sqlite3_stmt *stmt = nullptr;
     ASSERT_DATABASE_OK(sqlite3_prepare_v2(conn, query.c_str(), -1, &stmt, nullptr));
+    timer.prepared();
     int idx = 1;
+    std::unordered_set<std::string> compressed = ColumnCodec::instance().compressedColumns(conn, tableName);
     for (auto &column : columns)
-        ASSERT_DATABASE_OK(sqlite3_bind_text(stmt, idx++, column.second.c_str(), -1, SQLITE_TRANSIENT));
+        if (compressed.count(column.first))
+            ASSERT_DATABASE_OK(ColumnCodec::bind(stmt, idx++, ColumnCodec::encode(column.second)));
+        else
+            ASSERT_DATABASE_OK(sqlite3_bind_text(stmt, idx++, column.second.c_str(), -1, SQLITE_TRANSIENT));
     for (auto &condition : conditions)
         ASSERT_DATABASE_OK(sqlite3_bind_text(stmt, idx++, condition.second.c_str(), -1, SQLITE_TRANSIENT));
     ASSERT_DATABASE_OK(sqlite3_step(stmt));
     ASSERT_DATABASE_OK(sqlite3_finalize(stmt));
+    timer.finish(sqlite3_changes(conn));
 }
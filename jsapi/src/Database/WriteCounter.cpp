@@ -0,0 +1,121 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "WriteCounter.hpp"
+#include <Exceptions/AssertFailed.hpp>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+namespace
+{
+    std::atomic<uint64_t> written{0};
+    sqlite3_vfs *base = nullptr;
+    sqlite3_vfs counting;
+
+    // The wrapped file follows this header in the memory SQLite allocates
+    struct CountingFile
+    {
+        sqlite3_file file;
+        sqlite3_file *real;
+    };
+    sqlite3_file *real(sqlite3_file *file) { return reinterpret_cast<CountingFile *>(file)->real; }
+
+    int close(sqlite3_file *file) { return real(file)->pMethods->xClose(real(file)); }
+    int read(sqlite3_file *file, void *buffer, int amount, sqlite3_int64 offset)
+    {
+        return real(file)->pMethods->xRead(real(file), buffer, amount, offset);
+    }
+    int write(sqlite3_file *file, const void *buffer, int amount, sqlite3_int64 offset)
+    {
+        int res = real(file)->pMethods->xWrite(real(file), buffer, amount, offset);
+        if (res == SQLITE_OK)
+            written += amount;
+        return res;
+    }
+    int truncate(sqlite3_file *file, sqlite3_int64 size) { return real(file)->pMethods->xTruncate(real(file), size); }
+    int sync(sqlite3_file *file, int flags) { return real(file)->pMethods->xSync(real(file), flags); }
+    int fileSize(sqlite3_file *file, sqlite3_int64 *size) { return real(file)->pMethods->xFileSize(real(file), size); }
+    int lock(sqlite3_file *file, int level) { return real(file)->pMethods->xLock(real(file), level); }
+    int unlock(sqlite3_file *file, int level) { return real(file)->pMethods->xUnlock(real(file), level); }
+    int checkReservedLock(sqlite3_file *file, int *out) { return real(file)->pMethods->xCheckReservedLock(real(file), out); }
+    int fileControl(sqlite3_file *file, int op, void *arg) { return real(file)->pMethods->xFileControl(real(file), op, arg); }
+    int sectorSize(sqlite3_file *file) { return real(file)->pMethods->xSectorSize(real(file)); }
+    int deviceCharacteristics(sqlite3_file *file) { return real(file)->pMethods->xDeviceCharacteristics(real(file)); }
+    // The shared-memory index of a WAL lives in memory mapped from a file
+    // SQLite never writes through xWrite, so it is not counted
+    int shmMap(sqlite3_file *file, int region, int size, int extend, void volatile **pointer)
+    {
+        return real(file)->pMethods->xShmMap(real(file), region, size, extend, pointer);
+    }
+    int shmLock(sqlite3_file *file, int offset, int count, int flags)
+    {
+        return real(file)->pMethods->xShmLock(real(file), offset, count, flags);
+    }
+    void shmBarrier(sqlite3_file *file) { real(file)->pMethods->xShmBarrier(real(file)); }
+    int shmUnmap(sqlite3_file *file, int deleteFlag) { return real(file)->pMethods->xShmUnmap(real(file), deleteFlag); }
+    int fetch(sqlite3_file *file, sqlite3_int64 offset, int amount, void **pointer)
+    {
+        return real(file)->pMethods->xFetch(real(file), offset, amount, pointer);
+    }
+    int unfetch(sqlite3_file *file, sqlite3_int64 offset, void *pointer)
+    {
+        return real(file)->pMethods->xUnfetch(real(file), offset, pointer);
+    }
+
+    // One table per version of the wrapped file's methods, so SQLite never
+    // calls through to a method the wrapped file lacks
+    sqlite3_io_methods methods[3];
+
+    int open(sqlite3_vfs *, const char *name, sqlite3_file *file, int flags, int *outFlags)
+    {
+        CountingFile *counted = reinterpret_cast<CountingFile *>(file);
+        counted->real = reinterpret_cast<sqlite3_file *>(counted + 1);
+        int res = base->xOpen(base, name, counted->real, flags, outFlags);
+        const sqlite3_io_methods *realMethods = counted->real->pMethods;
+        counted->file.pMethods = realMethods ? &methods[std::min(realMethods->iVersion, 3) - 1] : nullptr;
+        return res;
+    }
+}
+
+void WriteCounter::install()
+{
+    static std::once_flag installed;
+    std::call_once(installed, []()
+                   {
+                       base = sqlite3_vfs_find(nullptr);
+                       ASSERT(base != nullptr);
+                       for (int version = 1; version <= 3; version++)
+                           methods[version - 1] = {version, close, read, write, truncate, sync, fileSize, lock, unlock,
+                                                   checkReservedLock, fileControl, sectorSize, deviceCharacteristics,
+                                                   version >= 2 ? shmMap : nullptr, version >= 2 ? shmLock : nullptr,
+                                                   version >= 2 ? shmBarrier : nullptr, version >= 2 ? shmUnmap : nullptr,
+                                                   version >= 3 ? fetch : nullptr, version >= 3 ? unfetch : nullptr};
+                       // Everything but opening a file goes straight to the default VFS
+                       counting = *base;
+                       counting.zName = "write-counter";
+                       counting.pNext = nullptr;
+                       counting.szOsFile = sizeof(CountingFile) + base->szOsFile;
+                       counting.xOpen = open;
+                       int res = sqlite3_vfs_register(&counting, 1);
+                       ASSERT(res == SQLITE_OK); });
+}
+
+uint64_t WriteCounter::bytesWritten()
+{
+    return written.load();
+}
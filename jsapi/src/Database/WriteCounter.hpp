@@ -0,0 +1,32 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <sqlite3/sqlite3.h>
+#include <cstdint>
+
+// Counts the bytes SQLite writes to files: database pages, WAL frames,
+// journals and snapshots alike, across every connection of the process.
+// It is a VFS wrapping the default one, made the default itself by
+// install(), which DATABASE calls before it opens anything.
+class WriteCounter
+{
+public:
+    static void install();
+    static uint64_t bytesWritten();
+};
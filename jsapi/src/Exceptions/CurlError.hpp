@@ -30,4 +30,9 @@ public:
         : Exception(file, line,
                     "CURL error " + std::to_string(errorCode) + ": " +
                         std::string(curl_easy_strerror(errorCode))) {}
+    CurlError(const char *file, int line,
+              CURLMcode errorCode)
+        : Exception(file, line,
+                    "CURL multi error " + std::to_string(errorCode) + ": " +
+                        std::string(curl_multi_strerror(errorCode))) {}
 };
@@ -17,8 +17,10 @@
 
 #include "Fetch.hpp"
 #include "strUtils.hpp"
+#include <Exceptions/AssertFailed.hpp>
+#include <algorithm>
 #include <iostream>
-#include <sstream>
+#include <thread>
 
 Response::Response(int status, std::string body) : status(status), body(body), ok(status >= 200 && status < 300) {}
 nlohmann::json Response::json()
@@ -35,45 +37,69 @@ nlohmann::json Response::json()
 std::string Response::text() { return body; }
 bool Response::isOk() { return ok; }
 
-size_t Fetch::WriteCallback(void *contents, size_t size, size_t nmemb, std::string *data)
+bool CancellationToken::cancel()
+{
+    if (cancelled.exchange(true))
+        return false;
+    std::lock_guard<std::mutex> lock(multiMutex);
+#if LIBCURL_VERSION_NUM >= 0x074400
+    if (multi)
+        curl_multi_wakeup(multi);
+#endif
+    return true;
+}
+void CancellationToken::attach(CURLM *handle)
+{
+    std::lock_guard<std::mutex> lock(multiMutex);
+    ASSERT(multi == nullptr || multi == handle);
+    multi = handle;
+}
+void CancellationToken::detach()
+{
+    std::lock_guard<std::mutex> lock(multiMutex);
+    multi = nullptr;
+}
+
+size_t Fetch::WriteCallback(void *contents, size_t size, size_t nmemb, void *userdata)
 {
     size_t totalSize = size * nmemb;
-    data->append((char *)contents, totalSize);
+    Transfer *transfer = static_cast<Transfer *>(userdata);
+    if (!transfer->claim())
+        return 0;
+    transfer->responseBody.append((char *)contents, totalSize);
     return totalSize;
 }
 
 static int xferinfo(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
 {
     const FetchOptions *options = static_cast<const FetchOptions *>(clientp);
-    if (options && options->cancelled && options->cancelled->load())
+    if (options && options->cancelled && options->cancelled->isCancelled())
         return 1;
     return 0;
 }
+// Errors in one event are reported and skipped so the rest of the stream
+// still reaches the caller
+Fetch::StreamContext::StreamContext(const FetchOptions &options)
+    : options(options), parser([&options](const SseEvent &event)
+                               {
+                                   try
+                                   {
+                                       options.streamCallback(event);
+                                   }
+                                   catch (const std::exception &e)
+                                   {
+                                       std::cerr << "Stream callback error: " << e.what() << std::endl;
+                                   } }) {}
 size_t Fetch::StreamWriteCallback(void *contents, size_t size, size_t nmemb, void *userdata)
 {
     size_t totalSize = size * nmemb;
-    try
-    {
-        const FetchOptions *options = static_cast<const FetchOptions *>(userdata);
-        if (options && options->cancelled && options->cancelled->load())
-            return 0;
-        if (options && options->streamCallback)
-        {
-            std::string chunk((char *)contents, totalSize);
-            std::istringstream stream(chunk);
-            std::string line;
-            while (std::getline(stream, line))
-            {
-                line = strUtils::trimEnd(line);
-                if (line.substr(0, 6) == "data: ")
-                    options->streamCallback(line.substr(6));
-            }
-        }
-    }
-    catch (const std::exception &e)
-    {
-        std::cerr << "Stream write callback error: " << e.what() << std::endl;
-    }
+    Transfer *transfer = static_cast<Transfer *>(userdata);
+    StreamContext *context = &transfer->streamContext;
+    if (context->options.cancelled && context->options.cancelled->isCancelled())
+        return 0;
+    if (!transfer->claim())
+        return 0;
+    context->parser.feed(static_cast<const char *>(contents), totalSize);
     return totalSize;
 }
 size_t Fetch::HeaderCallback(char *buffer, size_t size, size_t nitems, std::unordered_map<std::string, std::string> *headers)
@@ -91,16 +117,31 @@ size_t Fetch::HeaderCallback(char *buffer, size_t size, size_t nitems, std::unor
     return totalSize;
 }
 
-Response Fetch::fetch(const std::string &url, const FetchOptions &options)
+Fetch::Transfer::Transfer(const std::string &url, const FetchOptions &options)
+    : curl(curl_easy_init()), streamContext(options)
 {
-    CURL *curl = curl_easy_init();
     if (!curl)
         THROW_CURL_ERROR(CURLE_FAILED_INIT);
-
-    long responseCode = 0;
-    std::string responseBody;
-    std::unordered_map<std::string, std::string> responseHeaders;
-
+    try
+    {
+        setup(url, options);
+    }
+    catch (...)
+    {
+        if (headers)
+            curl_slist_free_all(headers);
+        curl_easy_cleanup(curl);
+        throw;
+    }
+}
+Fetch::Transfer::~Transfer()
+{
+    if (headers)
+        curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+}
+void Fetch::Transfer::setup(const std::string &url, const FetchOptions &options)
+{
     ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_URL, url.c_str()));
     ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback));
     ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_HEADERDATA, &responseHeaders));
@@ -120,12 +161,12 @@ Response Fetch::fetch(const std::string &url, const FetchOptions &options)
     if (options.stream && options.streamCallback)
     {
         ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, StreamWriteCallback));
-        ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_WRITEDATA, &options));
+        ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_WRITEDATA, this));
     }
     else
     {
         ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback));
-        ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_WRITEDATA, &responseBody));
+        ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_WRITEDATA, this));
     }
 
     if (options.method == "GET")
@@ -134,30 +175,250 @@ Response Fetch::fetch(const std::string &url, const FetchOptions &options)
     {
         ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_POST, 1L));
         if (!options.body.empty())
-            ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_POSTFIELDS, options.body.c_str()));
+        {
+            // curl reads the body in place; the size spares it a strlen
+            ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)options.body.size()));
+            ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_POSTFIELDS, options.body.data()));
+        }
     }
     else
     {
         ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, options.method.c_str()));
         if (!options.body.empty())
-            ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_POSTFIELDS, options.body.c_str()));
+        {
+            // curl reads the body in place; the size spares it a strlen
+            ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)options.body.size()));
+            ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_POSTFIELDS, options.body.data()));
+        }
     }
 
-    struct curl_slist *headers = nullptr;
     for (const auto &header : options.headers)
         headers = curl_slist_append(headers, std::string(header.first + ": " + header.second).c_str());
     if (headers)
         ASSERT_CURL_OK(curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers));
+}
+Response Fetch::Transfer::finish(CURLcode result)
+{
+    const FetchOptions &options = streamContext.options;
+    if (result == CURLE_OK && options.stream && options.streamCallback && !(options.cancelled && options.cancelled->isCancelled()))
+        streamContext.parser.finish();
 
-    ASSERT_CURL_OK(curl_easy_perform(curl));
-
+    long responseCode = 0;
     ASSERT_CURL_OK(curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode));
 
-    if (headers)
-        curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-
-    Response response(responseCode, responseBody);
-    response.headers = responseHeaders;
+    Response response(responseCode, std::move(responseBody));
+    response.headers = std::move(responseHeaders);
+    response.curlCode = result;
     return response;
 }
+
+bool Fetch::Transfer::claim()
+{
+    if (firstByte == std::chrono::steady_clock::time_point{})
+        firstByte = std::chrono::steady_clock::now();
+    if (!winner)
+        return true;
+    if (*winner == NO_WINNER)
+        *winner = attempt;
+    return *winner == attempt;
+}
+
+Response Fetch::fetch(const std::string &url, const FetchOptions &options)
+{
+    Transfer transfer(url, options);
+    CURLcode result = curl_easy_perform(transfer.curl);
+    ASSERT_CURL_OK(result);
+    return transfer.finish(result);
+}
+
+std::vector<Response> Fetch::fetchAll(const std::vector<std::pair<std::string, FetchOptions>> &requests)
+{
+    using Clock = std::chrono::steady_clock;
+    // Every request starts as attempt 0 at the same index; hedges are appended
+    struct Attempt
+    {
+        std::unique_ptr<Transfer> transfer;
+        size_t request;
+        Clock::time_point started;
+        CURLcode result = CURLE_OK;
+        bool active = false;
+    };
+    std::vector<Attempt> attempts;
+    std::vector<size_t> winners(requests.size(), NO_WINNER);
+    std::vector<bool> hedged(requests.size(), false);
+    Clock::time_point start = Clock::now();
+    std::vector<Clock::time_point> lastTick(requests.size(), start);
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        attempts.push_back(Attempt{std::make_unique<Transfer>(requests[i].first, requests[i].second), i, start});
+        if (requests[i].second.hedgeDelayMs > 0)
+            attempts.back().transfer->winner = &winners[i];
+    }
+
+    CURLM *multi = curl_multi_init();
+    if (!multi)
+        THROW_CURL_ERROR(CURLE_FAILED_INIT);
+    // Tokens let go of the multi handle before it is freed, so a late cancel()
+    // never wakes a dangling one
+    auto release = [&multi, &attempts, &requests]()
+    {
+        for (const auto &request : requests)
+            if (request.second.cancelled)
+                request.second.cancelled->detach();
+        for (const auto &attempt : attempts)
+            curl_multi_remove_handle(multi, attempt.transfer->curl);
+        curl_multi_cleanup(multi);
+    };
+    for (const auto &request : requests)
+        if (request.second.cancelled)
+            request.second.cancelled->attach(multi);
+
+    size_t remaining = 0;
+    auto drop = [&multi, &remaining](Attempt &attempt)
+    {
+        curl_multi_remove_handle(multi, attempt.transfer->curl);
+        attempt.result = CURLE_ABORTED_BY_CALLBACK;
+        attempt.active = false, remaining--;
+    };
+    CURLMcode code = CURLM_OK;
+    for (size_t i = 0; i < attempts.size() && code == CURLM_OK; i++)
+        if ((code = curl_multi_add_handle(multi, attempts[i].transfer->curl)) == CURLM_OK)
+            attempts[i].active = true, remaining++;
+    while (code == CURLM_OK)
+    {
+        // A cancelled transfer leaves the multi handle here rather than on
+        // curl's next callback, which a stalled connection may not make soon.
+        // The same goes for the attempt that lost its race.
+        for (auto &attempt : attempts)
+        {
+            if (!attempt.active)
+                continue;
+            const auto &cancelled = requests[attempt.request].second.cancelled;
+            size_t winner = winners[attempt.request];
+            if ((cancelled && cancelled->isCancelled()) || (winner != NO_WINNER && winner != attempt.transfer->attempt))
+                drop(attempt);
+        }
+
+        // A request still silent at its hedge delay gets a second attempt;
+        // until then the poll wakes up in time for it
+        Clock::time_point now = Clock::now();
+        long long pollTimeoutMs = MULTI_POLL_TIMEOUT_MS;
+        for (size_t i = 0; i < requests.size() && code == CURLM_OK; i++)
+        {
+            size_t hedgeDelayMs = requests[i].second.hedgeDelayMs;
+            if (hedgeDelayMs == 0 || hedged[i] || winners[i] != NO_WINNER || !attempts[i].active)
+                continue;
+            Clock::time_point deadline = start + std::chrono::milliseconds(hedgeDelayMs);
+            if (now < deadline)
+            {
+                pollTimeoutMs = std::min(pollTimeoutMs,
+                                         (long long)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1);
+                continue;
+            }
+            hedged[i] = true;
+            try
+            {
+                attempts.push_back(Attempt{std::make_unique<Transfer>(requests[i].first, requests[i].second), i, now});
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Failed to start hedged attempt: " << e.what() << std::endl;
+                continue;
+            }
+            attempts.back().transfer->winner = &winners[i];
+            attempts.back().transfer->attempt = 1;
+            if ((code = curl_multi_add_handle(multi, attempts.back().transfer->curl)) == CURLM_OK)
+                attempts.back().active = true, remaining++;
+        }
+        if (code != CURLM_OK || remaining == 0)
+            break;
+
+        // Ticks are due on time for the requests still running, however quiet
+        // their connections are
+        std::vector<bool> inFlight(requests.size(), false);
+        for (const auto &attempt : attempts)
+            if (attempt.active)
+                inFlight[attempt.request] = true;
+        for (size_t i = 0; i < requests.size(); i++)
+        {
+            const FetchOptions &options = requests[i].second;
+            if (!options.tickCallback || options.tickIntervalMs == 0 || !inFlight[i])
+                continue;
+            std::chrono::milliseconds interval(options.tickIntervalMs);
+            if (now - lastTick[i] >= interval)
+            {
+                lastTick[i] = now;
+                try
+                {
+                    options.tickCallback();
+                }
+                catch (const std::exception &e)
+                {
+                    std::cerr << "Tick callback failed: " << e.what() << std::endl;
+                }
+            }
+            pollTimeoutMs = std::min(pollTimeoutMs,
+                                     (long long)std::chrono::duration_cast<std::chrono::milliseconds>(lastTick[i] + interval - now).count() + 1);
+        }
+
+        int running = 0;
+        code = curl_multi_perform(multi, &running);
+        CURLMsg *message;
+        int queued;
+        while (code == CURLM_OK && (message = curl_multi_info_read(multi, &queued)))
+        {
+            if (message->msg != CURLMSG_DONE)
+                continue;
+            for (auto &attempt : attempts)
+                if (attempt.active && attempt.transfer->curl == message->easy_handle)
+                {
+                    attempt.result = message->data.result;
+                    attempt.active = false, remaining--;
+                    // A complete answer without a body still settles the race
+                    size_t &winner = winners[attempt.request];
+                    if (attempt.transfer->winner && winner == NO_WINNER && attempt.result == CURLE_OK)
+                        winner = attempt.transfer->attempt;
+                }
+        }
+        if (code != CURLM_OK || remaining == 0)
+            break;
+#if LIBCURL_VERSION_NUM >= 0x074400
+        code = curl_multi_poll(multi, nullptr, 0, (int)pollTimeoutMs, nullptr);
+#else
+        // curl_multi_wait returns at once when there is no socket to wait on yet
+        int descriptors = 0;
+        code = curl_multi_wait(multi, nullptr, 0, (int)pollTimeoutMs, &descriptors);
+        if (code == CURLM_OK && descriptors == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::min(pollTimeoutMs, 10LL)));
+#endif
+    }
+    release();
+    if (code != CURLM_OK)
+        throw CurlError(__FILE__, __LINE__, code);
+
+    // Each request answers with its winner; failing that, with an attempt
+    // that completed, or else with its first attempt
+    auto sinceStart = [start](Clock::time_point time)
+    { return time == Clock::time_point{} ? 0 : (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(time - start).count(); };
+    std::vector<Response> responses;
+    responses.reserve(requests.size());
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        std::vector<FetchAttempt> report;
+        size_t chosen = i;
+        for (size_t j = 0; j < attempts.size(); j++)
+        {
+            if (attempts[j].request != i)
+                continue;
+            const Transfer &transfer = *attempts[j].transfer;
+            report.push_back(FetchAttempt{sinceStart(attempts[j].started), sinceStart(transfer.firstByte), attempts[j].result});
+            if (winners[i] != NO_WINNER ? winners[i] == transfer.attempt
+                                        : attempts[j].result == CURLE_OK && attempts[chosen].result != CURLE_OK)
+                chosen = j;
+        }
+        report[attempts[chosen].transfer->attempt].won = true;
+        responses.push_back(attempts[chosen].transfer->finish(attempts[chosen].result));
+        responses.back().attempts = std::move(report);
+    }
+    return responses;
+}
@@ -21,9 +21,16 @@
 #include <unordered_map>
 #include <functional>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
 #include <Exceptions/CurlError.hpp>
+#include "SseParser.hpp"
 
 #define ASSERT_CURL_OK(expr)                                     \
     do                                                           \
@@ -33,7 +40,39 @@
             THROW_CURL_ERROR(res);                               \
     } while (false)
 
-using StreamCallback = std::function<void(const std::string &chunk)>;
+using StreamCallback = std::function<void(const SseEvent &event)>;
+
+// Cancels the transfers whose FetchOptions carry it. While fetchAll runs
+// them, cancel() wakes its poll, so they are dropped at once even when no
+// bytes are arriving; a plain fetch notices on curl's next callback.
+class CancellationToken
+{
+private:
+    std::atomic<bool> cancelled{false};
+    std::mutex multiMutex;
+    CURLM *multi = nullptr;
+
+    friend class Fetch;
+    void attach(CURLM *handle);
+    void detach();
+
+public:
+    // Returns false when the token was cancelled already
+    bool cancel();
+    bool isCancelled() const { return cancelled.load(); }
+};
+
+// One attempt of a request made by fetchAll; a hedged request has two.
+// Times are microseconds from the start of the request, 0 when it never
+// came to pass.
+struct FetchAttempt
+{
+    uint64_t startedUs = 0;
+    uint64_t firstByteUs = 0;
+    CURLcode result = CURLE_OK;
+    // Its response is the one returned
+    bool won = false;
+};
 
 class Response
 {
@@ -42,6 +81,10 @@ public:
     std::unordered_map<std::string, std::string> headers;
     std::string body;
     bool ok;
+    // fetchAll reports a failed transfer here instead of throwing
+    CURLcode curlCode = CURLE_OK;
+    // Filled in by fetchAll, in the order the attempts started
+    std::vector<FetchAttempt> attempts;
 
     Response(int status, std::string body);
     nlohmann::json json();
@@ -59,7 +102,15 @@ public:
     StreamCallback streamCallback;
     size_t timeout;
     bool followRedirects = true;
-    std::shared_ptr<std::atomic<bool>> cancelled;
+    std::shared_ptr<CancellationToken> cancelled;
+    // fetchAll only: when no byte of the body has arrived this many
+    // milliseconds in, an identical second attempt is started. Whichever
+    // receives a byte first is the one delivered; the other is dropped.
+    size_t hedgeDelayMs = 0;
+    // fetchAll only: called on the fetching thread every tickIntervalMs
+    // while the request runs, whether or not bytes are arriving
+    std::function<void()> tickCallback;
+    size_t tickIntervalMs = 0;
 
     FetchOptions(std::string method = "GET",
                  std::unordered_map<std::string, std::string> headers = {},
@@ -67,19 +118,65 @@ public:
                  bool stream = false,
                  StreamCallback streamCallback = nullptr,
                  size_t timeout = 10,
-                 std::shared_ptr<std::atomic<bool>> cancelled = nullptr)
-        : method(method), headers(headers), body(body),
-          stream(stream), streamCallback(streamCallback), timeout(timeout),
-          cancelled(cancelled) {}
+                 std::shared_ptr<CancellationToken> cancelled = nullptr)
+        : method(std::move(method)), headers(std::move(headers)), body(std::move(body)),
+          stream(stream), streamCallback(std::move(streamCallback)), timeout(timeout),
+          cancelled(std::move(cancelled)) {}
 };
 
 class Fetch
 {
 private:
-    static size_t WriteCallback(void *contents, size_t size, size_t nmemb, std::string *data);
+    struct StreamContext
+    {
+        const FetchOptions &options;
+        SseParser parser;
+
+        explicit StreamContext(const FetchOptions &options);
+    };
+    // One configured easy handle and everything it writes into
+    struct Transfer
+    {
+        CURL *curl;
+        struct curl_slist *headers = nullptr;
+        std::string responseBody;
+        std::unordered_map<std::string, std::string> responseHeaders;
+        StreamContext streamContext;
+        // The attempts of a hedged request share the index of the one whose
+        // body arrived first; nullptr when there is nothing to race
+        size_t *winner = nullptr;
+        size_t attempt = 0;
+        std::chrono::steady_clock::time_point firstByte;
+
+        Transfer(const std::string &url, const FetchOptions &options);
+        Transfer(const Transfer &) = delete;
+        Transfer &operator=(const Transfer &) = delete;
+        ~Transfer();
+        Response finish(CURLcode result);
+        // Called with each piece of the body; false once a rival attempt won
+        bool claim();
+
+    private:
+        void setup(const std::string &url, const FetchOptions &options);
+    };
+#if LIBCURL_VERSION_NUM >= 0x074400
+    // Cancellation wakes the poll itself; this only bounds a wait curl did not ask for
+    static constexpr int MULTI_POLL_TIMEOUT_MS = 1000;
+#else
+    // Before libcurl 7.68 nothing can wake the wait, so it is kept short
+    // enough for a cancel to be noticed when it ends
+    static constexpr int MULTI_POLL_TIMEOUT_MS = 50;
+#endif
+    static constexpr size_t NO_WINNER = SIZE_MAX;
+
+    static size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userdata);
     static size_t StreamWriteCallback(void *contents, size_t size, size_t nmemb, void *userdata);
     static size_t HeaderCallback(char *buffer, size_t size, size_t nitems, std::unordered_map<std::string, std::string> *headers);
 
 public:
     static Response fetch(const std::string &url, const FetchOptions &options = FetchOptions{});
+    // Runs the requests concurrently on the calling thread over one multi
+    // handle; responses come back in request order. A transfer that fails
+    // or is cancelled does not stop the others.
+    static std::vector<Response> fetchAll(const std::vector<std::pair<std::string, FetchOptions>> &requests);
 };
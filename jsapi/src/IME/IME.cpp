@@ -18,18 +18,24 @@
 #include "IME.hpp"
 #include "strUtils.hpp"
 #include <algorithm>
+#include <iostream>
 #include <sstream>
 #include <string.h>
 #include <stdlib.h>
 #include "rawdict_data.hpp"
 
-IME::IME() : database("/userdisk/database/langningchen-ime.db")
+// Learned frequencies are cheap to lose, so they live in memory and reach flash at most every 10 s
+IME::IME() : database(DATABASE_DIR "langningchen-ime.db", 64, DatabaseOptions::memory(10000, 2000))
 {
-    database.table("ime_dict")
-        .column("pinyin", TABLE::TEXT, TABLE::NOT_NULL)
-        .column("hanZi", TABLE::TEXT, TABLE::NOT_NULL | TABLE::UNIQUE)
-        .column("freq", TABLE::REAL, TABLE::NOT_NULL)
-        .execute();
+    database.write(
+        [](DATABASE &database)
+        {
+            database.table("ime_dict")
+                .column("pinyin", TABLE::TEXT, TABLE::NOT_NULL)
+                .column("hanZi", TABLE::TEXT, TABLE::NOT_NULL | TABLE::UNIQUE)
+                .column("freq", TABLE::REAL, TABLE::NOT_NULL)
+                .execute();
+        });
 
     pinyinDict.reserve(100000);
     pinyinUnits.reserve(500);
@@ -162,7 +168,10 @@ void IME::initialize()
             }
     }
 
-    auto rows = database.select("ime_dict").select("pinyin").select("hanZi").select("freq").execute();
+    auto rows = database.read(
+                            [](DATABASE &database)
+                            { return database.select("ime_dict").select("pinyin").select("hanZi").select("freq").execute(); })
+                    .get();
     for (const auto &row : rows)
     {
         Pinyin pinyin = strUtils::split(row.at("pinyin"), " ");
@@ -205,23 +214,36 @@ void IME::updateWordFrequency(const Pinyin &pinyin, const std::string &hanZi)
     insert(pinyin, hanZi, newFreq);
 
     std::string pinyinStr = strUtils::join(pinyin, " ");
-    auto data = database.select("ime_dict").where("pinyin", pinyinStr).where("hanZi", hanZi).execute();
-    if (data.empty())
-    {
-        database.insert("ime_dict")
-            .value("pinyin", pinyinStr)
-            .value("hanZi", hanZi)
-            .value("freq", newFreq)
-            .execute();
-    }
-    else
-    {
-        database.update("ime_dict")
-            .set("freq", std::to_string(newFreq))
-            .where("pinyin", pinyinStr)
-            .where("hanZi", hanZi)
-            .execute();
-    }
+    database.write(
+        [pinyinStr, hanZi, newFreq](DATABASE &database)
+        {
+            // Nobody waits on this job, so its failure is reported here
+            try
+            {
+                auto data = database.select("ime_dict").where("pinyin", pinyinStr).where("hanZi", hanZi).execute();
+                if (data.empty())
+                {
+                    database.insert("ime_dict")
+                        .value("pinyin", pinyinStr)
+                        .value("hanZi", hanZi)
+                        .value("freq", newFreq)
+                        .execute();
+                }
+                else
+                {
+                    database.update("ime_dict")
+                        .set("freq", std::to_string(newFreq))
+                        .where("pinyin", pinyinStr)
+                        .where("hanZi", hanZi)
+                        .execute();
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Failed to save frequency of " << hanZi << ": " << e.what() << std::endl;
+                throw;
+            }
+        });
 }
 Pinyin IME::splitPinyin(const std::string &rawPinyin)
 {
@@ -0,0 +1,120 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "PublishCoalescer.hpp"
+#include <iostream>
+
+PublishCoalescer::PublishCoalescer(Publisher publisher, size_t intervalMs)
+    : publisher(std::move(publisher)), interval(intervalMs)
+{
+    worker = std::thread(&PublishCoalescer::run, this);
+}
+PublishCoalescer::~PublishCoalescer()
+{
+    stop();
+}
+
+void PublishCoalescer::append(const std::string &topic, const std::string &delta)
+{
+    if (delta.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        auto it = pending.begin();
+        while (it != pending.end() && it->first != topic)
+            ++it;
+        if (it == pending.end())
+            pending.emplace_back(topic, delta);
+        else
+        {
+            it->second += delta;
+            return;
+        }
+    }
+    stateCondition.notify_one();
+}
+
+void PublishCoalescer::flush()
+{
+    std::lock_guard<std::mutex> deliveryLock(deliveryMutex);
+    deliver();
+}
+
+void PublishCoalescer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    stateCondition.notify_one();
+    if (worker.joinable())
+        worker.join();
+}
+
+void PublishCoalescer::setInterval(size_t intervalMs)
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        interval = std::chrono::milliseconds(intervalMs);
+    }
+    stateCondition.notify_one();
+}
+
+// Must be called with deliveryMutex held
+void PublishCoalescer::deliver()
+{
+    std::vector<std::pair<std::string, std::string>> batch;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        batch.swap(pending);
+        lastDelivery = std::chrono::steady_clock::now();
+    }
+    for (const auto &topic : batch)
+    {
+        try
+        {
+            publisher(topic.first, topic.second);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Publish error on " << topic.first << ": " << e.what() << std::endl;
+        }
+    }
+}
+
+void PublishCoalescer::run()
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    while (true)
+    {
+        stateCondition.wait(lock, [this]
+                            { return stopping || !pending.empty(); });
+        while (!stopping && !pending.empty() &&
+               std::chrono::steady_clock::now() - lastDelivery < interval)
+            stateCondition.wait_until(lock, lastDelivery + interval);
+        if (stopping)
+            return;
+        if (pending.empty())
+            continue;
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> deliveryLock(deliveryMutex);
+            deliver();
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,69 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Merges text published on the same topic so the JS thread is woken at
+// most once per interval however fast the producer is. The first delta
+// after a quiet period goes out immediately; later ones are appended to
+// the topic's pending text and delivered together.
+class PublishCoalescer
+{
+public:
+    using Publisher = std::function<void(const std::string &topic, const std::string &payload)>;
+
+private:
+    Publisher publisher;
+    std::chrono::milliseconds interval;
+
+    // Topics in first-append order; there are only ever a handful
+    std::vector<std::pair<std::string, std::string>> pending;
+    std::chrono::steady_clock::time_point lastDelivery;
+    bool stopping = false;
+    std::mutex stateMutex;
+    std::condition_variable stateCondition;
+    // Held while publishing so a flush cannot overtake the worker
+    std::mutex deliveryMutex;
+    std::thread worker;
+
+    void deliver();
+    void run();
+
+public:
+    PublishCoalescer(Publisher publisher, size_t intervalMs);
+    PublishCoalescer(const PublishCoalescer &) = delete;
+    PublishCoalescer &operator=(const PublishCoalescer &) = delete;
+    ~PublishCoalescer();
+
+    void append(const std::string &topic, const std::string &delta);
+    // Delivers everything pending before returning
+    void flush();
+    // Joins the worker; anything appended after is only delivered by flush().
+    // The owner calls it and then flush() while the publisher is still valid,
+    // since the destructor drops whatever is pending.
+    void stop();
+    void setInterval(size_t intervalMs);
+};
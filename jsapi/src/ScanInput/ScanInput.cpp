@@ -18,7 +18,7 @@
 #include "ScanInput.hpp"
 #include <unistd.h>
 
-ScanInput::ScanInput() : database("/userdisk/database/history.db") {}
+ScanInput::ScanInput() : database(DATABASE_DIR "history.db") {}
 
 void ScanInput::initialize(ScanInputCallback callback)
 {
@@ -0,0 +1,170 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "SseParser.hpp"
+
+static constexpr std::string_view UTF8_BOM = "\xEF\xBB\xBF";
+
+SseParser::SseParser(EventCallback callback) : callback(std::move(callback)) {}
+
+void SseParser::feed(const char *chunk, size_t length)
+{
+    compact();
+    buffer.append(chunk, length);
+
+    if (!bomChecked)
+    {
+        if (buffer.size() < UTF8_BOM.size() && UTF8_BOM.compare(0, buffer.size(), buffer) == 0)
+            return;
+        if (std::string_view(buffer).substr(0, UTF8_BOM.size()) == UTF8_BOM)
+            buffer.erase(0, UTF8_BOM.size());
+        bomChecked = true;
+    }
+
+    while (true)
+    {
+        if (skipLineFeed)
+        {
+            if (scanPos >= buffer.size())
+                break;
+            if (buffer[scanPos] == '\n')
+                lineStart = ++scanPos;
+            skipLineFeed = false;
+        }
+
+        size_t end = buffer.find_first_of("\r\n", scanPos);
+        if (end == std::string::npos)
+        {
+            scanPos = buffer.size();
+            break;
+        }
+
+        skipLineFeed = buffer[end] == '\r';
+        processLine(lineStart, end);
+        lineStart = scanPos = end + 1;
+        if (dataLines == 0)
+            eventStart = lineStart;
+    }
+}
+
+void SseParser::finish()
+{
+    if (lineStart < buffer.size())
+        processLine(lineStart, buffer.size());
+    dispatch();
+    reset();
+}
+
+void SseParser::reset()
+{
+    buffer.clear();
+    eventStart = lineStart = scanPos = 0;
+    skipLineFeed = false;
+    bomChecked = false;
+    dataOffset = dataLength = dataLines = 0;
+    data.clear();
+    eventType.clear();
+    lastEventId.clear();
+}
+
+void SseParser::processLine(size_t begin, size_t end)
+{
+    if (begin == end)
+    {
+        dispatch();
+        return;
+    }
+    if (buffer[begin] == ':')
+        return;
+
+    std::string_view line(buffer.data() + begin, end - begin);
+    size_t colon = line.find(':');
+    std::string_view field = line.substr(0, colon);
+    size_t valueBegin = begin + field.size();
+    if (colon != std::string_view::npos)
+    {
+        valueBegin++;
+        if (valueBegin < end && buffer[valueBegin] == ' ')
+            valueBegin++;
+    }
+    std::string_view value(buffer.data() + valueBegin, end - valueBegin);
+
+    if (field == "data")
+    {
+        if (dataLines == 0)
+        {
+            dataOffset = valueBegin;
+            dataLength = value.size();
+        }
+        else
+        {
+            if (dataLines == 1)
+                data.assign(buffer, dataOffset, dataLength);
+            data += '\n';
+            data.append(value);
+        }
+        dataLines++;
+    }
+    else if (field == "event")
+        eventType.assign(value);
+    else if (field == "id")
+    {
+        if (value.find('\0') == std::string_view::npos)
+            lastEventId.assign(value);
+    }
+    // retry is meaningless here since requests are never reconnected
+}
+
+void SseParser::dispatch()
+{
+    if (dataLines == 0)
+    {
+        eventType.clear();
+        return;
+    }
+
+    SseEvent event;
+    event.event = eventType.empty() ? std::string_view("message") : std::string_view(eventType);
+    event.data = dataLines == 1 ? std::string_view(buffer.data() + dataOffset, dataLength) : std::string_view(data);
+    event.id = lastEventId;
+    callback(event);
+
+    dataOffset = dataLength = dataLines = 0;
+    data.clear();
+    eventType.clear();
+}
+
+// Drops bytes no longer referenced so the buffer does not grow with the
+// stream; its capacity is kept for the following chunks
+void SseParser::compact()
+{
+    if (eventStart == buffer.size())
+    {
+        buffer.clear();
+        eventStart = lineStart = scanPos = 0;
+        dataOffset = 0;
+        return;
+    }
+    if (eventStart == 0 || eventStart < buffer.size() / 2)
+        return;
+    buffer.erase(0, eventStart);
+    lineStart -= eventStart;
+    scanPos -= eventStart;
+    if (dataLines > 0)
+        dataOffset -= eventStart;
+    eventStart = 0;
+}
@@ -0,0 +1,77 @@
+// Copyright (C) 2025 Langning Chen
+//
+// This file is part of miniapp.
+//
+// miniapp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// miniapp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with miniapp.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <functional>
+
+// A dispatched Server-Sent Event. The views point into the parser's
+// buffers and are only valid for the duration of the callback.
+struct SseEvent
+{
+    std::string_view event;
+    std::string_view data;
+    std::string_view id;
+};
+
+// Incremental text/event-stream parser. Bytes are fed in arbitrary
+// fragments; lines split across fragments are kept in a reusable buffer
+// until they complete. Single-line data fields, the common case, are
+// handed out as views into that buffer without being copied.
+class SseParser
+{
+public:
+    using EventCallback = std::function<void(const SseEvent &event)>;
+
+private:
+    EventCallback callback;
+
+    std::string buffer;
+    // Nothing before this offset is referenced by the pending event
+    size_t eventStart = 0;
+    // Start of the line being read and where the search for its
+    // terminator resumes
+    size_t lineStart = 0;
+    size_t scanPos = 0;
+    bool skipLineFeed = false;
+    bool bomChecked = false;
+
+    // The first data line of the event is a range of the buffer; further
+    // lines are joined into data
+    size_t dataOffset = 0;
+    size_t dataLength = 0;
+    size_t dataLines = 0;
+    std::string data;
+    std::string eventType;
+    std::string lastEventId;
+
+    void processLine(size_t begin, size_t end);
+    void dispatch();
+    void compact();
+
+public:
+    explicit SseParser(EventCallback callback);
+
+    // The callback is invoked synchronously and must not throw
+    void feed(const char *chunk, size_t length);
+    // Ends the stream. A final event that lacks its blank line is still
+    // dispatched, as some servers close right after the last data line.
+    void finish();
+    void reset();
+};
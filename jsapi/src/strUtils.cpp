@@ -1,6 +1,7 @@
 #include "strUtils.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <random>
-#include <sstream>
 
 std::string strUtils::trim(const std::string &str) { return trimStart(trimEnd(str)); }
 std::string strUtils::trimEnd(const std::string &str)
@@ -16,14 +17,124 @@ std::string strUtils::trimStart(const std::string &str)
 
 std::string strUtils::randomId()
 {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<> dis(0, 15);
-    std::stringstream ss;
-    ss << std::hex;
-    for (int i = 0; i < 32; i++)
-        ss << dis(gen);
-    return ss.str();
+    // Two 64-bit draws give the 32 hex digits; ids are minted on every message
+    static thread_local std::mt19937_64 gen(std::random_device{}());
+    static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+    std::string id(32, '0');
+    for (size_t half = 0; half < 2; half++)
+    {
+        uint64_t bits = gen();
+        for (size_t i = 0; i < 16; i++, bits >>= 4)
+            id[half * 16 + i] = HEX_DIGITS[bits & 0xf];
+    }
+    return id;
+}
+
+static uint64_t rotateLeft(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+static uint64_t finalMix(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+std::string strUtils::hash128(std::string_view data)
+{
+    // MurmurHash3_x64_128 with seed 0
+    const uint64_t c1 = 0x87c37b91114253d5ULL, c2 = 0x4cf5ad432745937fULL;
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data.data());
+    size_t blocks = data.size() / 16;
+    uint64_t h1 = 0, h2 = 0;
+    auto load = [](const unsigned char *p)
+    {
+        uint64_t value = 0;
+        for (int i = 7; i >= 0; i--)
+            value = (value << 8) | p[i];
+        return value;
+    };
+    for (size_t i = 0; i < blocks; i++)
+    {
+        uint64_t k1 = load(bytes + i * 16), k2 = load(bytes + i * 16 + 8);
+        k1 *= c1, k1 = rotateLeft(k1, 31), k1 *= c2, h1 ^= k1;
+        h1 = rotateLeft(h1, 27), h1 += h2, h1 = h1 * 5 + 0x52dce729;
+        k2 *= c2, k2 = rotateLeft(k2, 33), k2 *= c1, h2 ^= k2;
+        h2 = rotateLeft(h2, 31), h2 += h1, h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const unsigned char *tail = bytes + blocks * 16;
+    size_t rest = data.size() & 15;
+    uint64_t k1 = 0, k2 = 0;
+    for (size_t i = rest; i > 8; i--)
+        k2 = (k2 << 8) | tail[i - 1];
+    for (size_t i = std::min<size_t>(rest, 8); i > 0; i--)
+        k1 = (k1 << 8) | tail[i - 1];
+    if (rest > 8)
+        k2 *= c2, k2 = rotateLeft(k2, 33), k2 *= c1, h2 ^= k2;
+    if (rest > 0)
+        k1 *= c1, k1 = rotateLeft(k1, 31), k1 *= c2, h1 ^= k1;
+
+    h1 ^= data.size(), h2 ^= data.size();
+    h1 += h2, h2 += h1;
+    h1 = finalMix(h1), h2 = finalMix(h2);
+    h1 += h2, h2 += h1;
+
+    static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+    std::string hash(32, '0');
+    uint64_t halves[2] = {h1, h2};
+    for (size_t half = 0; half < 2; half++)
+        for (size_t i = 0; i < 16; i++)
+            hash[half * 16 + i] = HEX_DIGITS[(halves[half] >> (60 - i * 4)) & 0xf];
+    return hash;
+}
+
+size_t strUtils::utf8Length(const std::string &str)
+{
+    size_t length = 0;
+    for (unsigned char ch : str)
+        if ((ch & 0xC0) != 0x80)
+            length++;
+    return length;
+}
+
+size_t strUtils::estimateTokens(const std::string &str)
+{
+    size_t asciiBytes = 0, otherCharacters = 0;
+    for (unsigned char ch : str)
+    {
+        if (ch < 0x80)
+            asciiBytes++;
+        else if ((ch & 0xC0) != 0x80)
+            otherCharacters++;
+    }
+    return (asciiBytes + 3) / 4 + otherCharacters;
+}
+
+std::string strUtils::utf8Prefix(const std::string &str, size_t length)
+{
+    size_t end = 0;
+    while (end < str.size())
+    {
+        if ((static_cast<unsigned char>(str[end]) & 0xC0) != 0x80 && length-- == 0)
+            break;
+        end++;
+    }
+    return str.substr(0, end);
+}
+
+std::string strUtils::utf8TrimPartial(const std::string &str)
+{
+    size_t start = str.size();
+    while (start > 0 && str.size() - start < 4 && (static_cast<unsigned char>(str[start - 1]) & 0xC0) == 0x80)
+        start--;
+    if (start == 0)
+        return str;
+    unsigned char lead = str[start - 1];
+    size_t expected = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+    if (str.size() - (start - 1) < expected)
+        return str.substr(0, start - 1);
+    return str;
 }
 
 std::vector<std::string> strUtils::split(const std::string &str, const std::string &delimiter)
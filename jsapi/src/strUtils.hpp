@@ -18,6 +18,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 class strUtils
@@ -28,6 +29,13 @@ public:
     static std::string trimStart(const std::string &str);
 
     static std::string randomId();
+    // 128-bit MurmurHash3 of data as 32 hex digits; a content key, not a cryptographic hash
+    static std::string hash128(std::string_view data);
+    static size_t utf8Length(const std::string &str);
+    static std::string utf8Prefix(const std::string &str, size_t length);
+    static std::string utf8TrimPartial(const std::string &str);
+    // Rough prompt token count: four ASCII bytes or one other character per token
+    static size_t estimateTokens(const std::string &str);
 
     static std::vector<std::string> split(const std::string &str, const std::string &delimiter);
     static std::string join(const std::vector<std::string> &vec, const std::string &delimiter);
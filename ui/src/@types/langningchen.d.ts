@@ -28,20 +28,37 @@ export declare class AI {
 
     static addUserMessage(message: string): Promise<void>;
     static generateResponse(): Promise<string>;
-    static stopGeneration(): void;
-    static getModels(): Promise<string[]>;
-    static getUserBalance(): Promise<number>;
+    static generateAlternatives(count: number): Promise<string[]>;
+    static stopGeneration(conversationId?: string): boolean;
+    static stopAlternative(branch: number): boolean;
+    static getModels(refresh?: boolean): Promise<string[]>;
+    static getUserBalance(refresh?: boolean): Promise<number>;
 
-    static getConversationList(): Promise<langningchen.ConversationNode[]>;
+    static getConversationList(afterUpdatedAt?: string, afterId?: string, limit?: number): Promise<langningchen.ConversationInfo[]>;
     static createConversation(title?: string): Promise<void>;
     static loadConversation(conversationId: string): Promise<void>;
     static deleteConversation(conversationId: string): Promise<void>;
     static updateConversationTitle(conversationId: string, title: string): Promise<void>;
+    static searchConversations(query: string, limit?: number): Promise<langningchen.SearchResult[]>;
+    static readNodeContent(nodeId: string, offset?: number, length?: number): Promise<langningchen.NodeContentChunk>;
 
-    static setSettings(apiKey: string, baseUrl: string, modelName: string, maxTokens: number, temperature: number, topP: number, systemPrompt: string): void;
+    static setSettings(apiKey: string, baseUrl: string, modelName: string, maxTokens: number, temperature: number, topP: number, systemPrompt: string, contextTokens?: number): void;
     static getSettings(): langningchen.SettingsResponse;
+    static setResponseCache(enabled: boolean, capacityBytes?: number): void;
+    static getResponseCacheInfo(): langningchen.ResponseCacheInfo;
+    static clearResponseCache(): void;
+    static setHedging(enabled: boolean, percentile?: number): void;
+    static getHedging(): langningchen.HedgingInfo;
 
-    static on(event: 'ai_stream', callback: (data: string) => void): void;
+    static getQueryStats(): langningchen.QueryStatsResponse;
+    static resetQueryStats(): void;
+    static setSlowQueryLog(thresholdMs: number, capacity: number): void;
+    static getGenerationStats(): langningchen.GenerationStatsResponse;
+    static resetGenerationStats(): void;
+    static setStreamPublishInterval(intervalMs: number): void;
+
+    static on(event: 'ai_stream', callback: (data: langningchen.StreamDelta) => void): void;
+    static on(event: 'ai_alternative', callback: (data: langningchen.AlternativeDelta) => void): void;
 }
 
 export declare class IME {
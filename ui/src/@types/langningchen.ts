@@ -46,6 +46,31 @@ export interface ConversationInfo {
     title: string;
     createdAt: number;
     updatedAt: number;
+    messageCount: number;
+    preview: string;
+}
+
+export interface SearchResult {
+    id: string;
+    title: string;
+    snippet: string;
+    updatedAt: string;
+}
+
+export interface NodeContentChunk {
+    content: string;
+    nextOffset: number;
+    totalLength: number;
+}
+
+export interface StreamDelta {
+    conversationId: string;
+    nodeId: string;
+    delta: string;
+}
+
+export interface AlternativeDelta extends StreamDelta {
+    branch: number;
 }
 
 
@@ -57,6 +82,78 @@ export interface SettingsResponse {
     temperature: number;
     topP: number;
     systemPrompt: string;
+    contextTokens: number;
+}
+
+export interface ResponseCacheInfo {
+    enabled: boolean;
+    capacityBytes: number;
+    usedBytes: number;
+    entries: number;
+}
+
+export interface HedgingInfo {
+    enabled: boolean;
+    percentile: number;
+    delayMs: number;
+}
+
+export interface QueryStat {
+    sql: string;
+    calls: number;
+    rows: number;
+    totalUs: number;
+    maxUs: number;
+    prepareUs: number;
+    stepUs: number;
+}
+
+export interface SlowQuery {
+    sql: string;
+    durationUs: number;
+    timestamp: string;
+}
+
+export interface QueryStatsResponse {
+    queries: QueryStat[];
+    slowQueries: SlowQuery[];
+}
+
+export interface GenerationSample {
+    timestamp: string;
+    firstTokenUs: number;
+    totalUs: number;
+    tokens: number;
+    persistUs: number;
+    bytesWritten: number;
+    cancelLatencyUs: number;
+    stopReason: number;
+    cached: boolean;
+    hedgeDelayUs: number;
+    attempts: number;
+    winningAttempt: number;
+    attemptFirstByteUs: number[];
+}
+
+export interface GenerationSummary {
+    samples: number;
+    firstTokenP50Ms: number;
+    firstTokenP90Ms: number;
+    firstTokenP99Ms: number;
+    tokensPerSecondP50: number;
+    tokensPerSecondP10: number;
+    persistP50Ms: number;
+    persistP90Ms: number;
+    cancelLatencyP50Ms: number;
+    cancelLatencyP90Ms: number;
+    bytesWrittenPerToken: number;
+    hedgedRate: number;
+    hedgeWinRate: number;
+}
+
+export interface GenerationStatsResponse {
+    samples: GenerationSample[];
+    summary: GenerationSummary;
 }
 
 
@@ -17,7 +17,7 @@
 
 import { defineComponent } from 'vue';
 import { AI } from 'langningchen';
-import { ROLE, ConversationNode, STOP_REASON } from '../../@types/langningchen';
+import { ROLE, ConversationNode, STOP_REASON, StreamDelta } from '../../@types/langningchen';
 import { showError } from '../../components/ToastMessage';
 import { openSoftKeyboard } from '../../utils/softKeyboardUtils';
 
@@ -29,8 +29,10 @@ const ai = defineComponent({
             $page: {} as FalconPage<aiOptions>,
             aiInitialized: false,
             currentInput: '',
-            streamingContent: '',
-            isStreaming: false,
+            // Conversations with a reply being generated, and the text streamed
+            // into each so far; generation carries on while others are open
+            generatingConversations: [] as string[],
+            streams: {} as Record<string, { nodeId: string, content: string }>,
             messages: [] as ConversationNode[],
             jumpToMessageId: '',
 
@@ -50,9 +52,15 @@ const ai = defineComponent({
             AI.initialize();
             this.aiInitialized = true;
             this.refreshMessages();
-            AI.on('ai_stream', (data: string) => {
-                this.streamingContent += data;
-                this.$forceUpdate();
+            AI.on('ai_stream', (data: StreamDelta) => {
+                let stream = this.streams[data.conversationId];
+                if (!stream || stream.nodeId !== data.nodeId) {
+                    stream = this.streams[data.conversationId] = { nodeId: data.nodeId, content: '' };
+                }
+                stream.content += data.delta;
+                if (data.conversationId === this.currentConversationId) {
+                    this.$forceUpdate();
+                }
             });
             $falcon.on<string>('jump', this.jumpHandler);
         } catch (e) {
@@ -70,28 +78,35 @@ const ai = defineComponent({
                 }
             }
 
-            if (this.isStreaming && this.streamingContent) {
-                const lastMessage = messages[messages.length - 1];
-                if (lastMessage && lastMessage.role === ROLE.ROLE_ASSISTANT) {
-                    lastMessage.content = this.streamingContent;
+            const stream = this.streams[this.currentConversationId];
+            if (this.isStreaming && stream) {
+                const streamingMessage = messages.find(msg => msg.id === stream.nodeId);
+                if (streamingMessage) {
+                    streamingMessage.content = stream.content;
                 }
-                else if (lastMessage) {
-                    const tempId = `streaming_${Date.now()}`;
-                    lastMessage.childIds.push(tempId);
-                    const streamingMessage: ConversationNode = {
-                        role: ROLE.ROLE_ASSISTANT,
-                        content: '',
-                        timestamp: new Date().toISOString(),
-                        id: '',
-                        parentId: '',
-                        childIds: [],
-                        stopReason: STOP_REASON.STOP_REASON_NONE
-                    };
-                    messages.push(streamingMessage);
+                else {
+                    const lastMessage = messages[messages.length - 1];
+                    if (lastMessage) {
+                        if (!lastMessage.childIds.includes(stream.nodeId)) {
+                            lastMessage.childIds.push(stream.nodeId);
+                        }
+                        messages.push({
+                            role: ROLE.ROLE_ASSISTANT,
+                            content: stream.content,
+                            timestamp: new Date().toISOString(),
+                            id: stream.nodeId,
+                            parentId: lastMessage.id,
+                            childIds: [],
+                            stopReason: STOP_REASON.STOP_REASON_NONE
+                        });
+                    }
                 }
             }
             return messages;
         },
+        isStreaming(): boolean {
+            return this.generatingConversations.includes(this.currentConversationId);
+        },
         canSendMessage(): boolean {
             return this.aiInitialized && !this.isStreaming && this.currentInput.trim().length > 0;
         }
@@ -109,6 +124,7 @@ const ai = defineComponent({
 
         refreshMessages() {
             try {
+                this.currentConversationId = AI.getCurrentConversationId();
                 this.messages = AI.getCurrentPath().map((node: ConversationNode) => ({ ...node, childIds: [...node.childIds] }));
             } catch (e) {
                 showError(e as string || '获取消息失败');
@@ -120,8 +136,6 @@ const ai = defineComponent({
             if (!this.canSendMessage) return;
             userMessage = userMessage.trim();
 
-            this.streamingContent = '';
-
             AI.addUserMessage(userMessage).then(() => {
                 this.refreshMessages();
                 this.$forceUpdate();
@@ -133,27 +147,24 @@ const ai = defineComponent({
         },
 
         async generateResponse() {
-            this.isStreaming = true;
-            AI.generateResponse().then(() => {
-                this.refreshMessages();
-                this.$forceUpdate();
-            }).catch((e) => {
+            const conversationId = this.currentConversationId;
+            this.generatingConversations.push(conversationId);
+            delete this.streams[conversationId];
+            AI.generateResponse().catch((e) => {
                 showError(e as string || '生成响应失败');
             }).finally(() => {
-                this.isStreaming = false;
-                this.streamingContent = '';
+                this.generatingConversations = this.generatingConversations.filter(id => id !== conversationId);
+                delete this.streams[conversationId];
+                if (conversationId === this.currentConversationId) {
+                    this.refreshMessages();
+                }
+                this.$forceUpdate();
             });
         },
 
         stopGeneration() {
             if (this.isStreaming) {
-                AI.stopGeneration();
-                setTimeout(() => {
-                    this.isStreaming = false;
-                    this.streamingContent = '';
-                    this.refreshMessages();
-                    this.$forceUpdate();
-                }, 100);
+                AI.stopGeneration(this.currentConversationId);
             }
         },
 
@@ -166,12 +177,10 @@ const ai = defineComponent({
         },
 
         openSettings() {
-            if (this.isStreaming) return;
             $falcon.navTo('aiSettings', {});
         },
 
         openHistory() {
-            if (this.isStreaming) return;
             $falcon.navTo('aiHistory', {});
         },
 
@@ -21,17 +21,22 @@ import { showError, showSuccess } from '../../components/ToastMessage';
 import { hideLoading, showLoading } from '../../components/Loading';
 import { openSoftKeyboard } from '../../utils/softKeyboardUtils';
 import { formatTime } from '../../utils/timeUtils';
+import { SearchResult } from '../../@types/langningchen';
 
 export type aiHistoryOptions = {};
 
+const PAGE_SIZE = 20;
+
 const aiHistory = defineComponent({
     data() {
         return {
             $page: {} as FalconPage<aiHistoryOptions>,
             conversationList: [] as any[],
+            hasMoreConversations: false,
             currentConversationId: '',
 
             searchKeyword: '',
+            searchResults: [] as SearchResult[],
         };
     },
 
@@ -46,23 +51,19 @@ const aiHistory = defineComponent({
 
     computed: {
         filteredConversations(): any[] {
-            let filtered = [...this.conversationList];
             if (this.searchKeyword) {
-                const keyword = this.searchKeyword.toLowerCase();
-                filtered = filtered.filter(conv => conv.title.toLowerCase().includes(keyword));
+                return this.searchResults;
             }
-            filtered.sort((a, b) => {
-                return b.updatedAt - a.updatedAt;
-            });
-            return filtered;
+            return this.conversationList;
         }
     },
 
     methods: {
         async loadConversationList() {
             showLoading();
-            AI.getConversationList().then((list) => {
+            AI.getConversationList('', '', PAGE_SIZE).then((list) => {
                 this.conversationList = list;
+                this.hasMoreConversations = list.length === PAGE_SIZE;
                 this.currentConversationId = AI.getCurrentConversationId();
             }).catch((e) => {
                 showError(e as string || '加载对话列表失败');
@@ -71,6 +72,20 @@ const aiHistory = defineComponent({
             });
         },
 
+        async loadMoreConversations() {
+            const last = this.conversationList[this.conversationList.length - 1];
+            if (!last || !this.hasMoreConversations) return;
+            showLoading();
+            AI.getConversationList(last.updatedAt, last.id, PAGE_SIZE).then((list) => {
+                this.conversationList = [...this.conversationList, ...list];
+                this.hasMoreConversations = list.length === PAGE_SIZE;
+            }).catch((e) => {
+                showError(e as string || '加载对话列表失败');
+            }).finally(() => {
+                hideLoading();
+            });
+        },
+
         async createConversation() {
             AI.createConversation(`新对话 ${Date.now()}`).then(() => {
                 return this.loadConversationList();
@@ -126,12 +141,27 @@ const aiHistory = defineComponent({
         editSearchKeyword() {
             openSoftKeyboard(
                 () => this.searchKeyword,
-                (value) => { this.searchKeyword = value; this.$forceUpdate(); }
+                (value) => { this.searchKeyword = value.trim(); this.searchConversations(); }
             );
         },
 
+        searchConversations() {
+            if (!this.searchKeyword) {
+                this.searchResults = [];
+                this.$forceUpdate();
+                return;
+            }
+            AI.searchConversations(this.searchKeyword, 50).then((results) => {
+                this.searchResults = results;
+                this.$forceUpdate();
+            }).catch((e) => {
+                showError(e as string || '搜索对话失败');
+            });
+        },
+
         clearSearch() {
             this.searchKeyword = '';
+            this.searchResults = [];
             this.$forceUpdate();
         },
 
@@ -32,9 +32,14 @@ const aiSettings = defineComponent({
             modelName: '',
 
             maxTokens: 0,
+            contextTokens: 0,
             temperature: 0,
             topP: 0,
             systemPrompt: '',
+            responseCacheEnabled: false,
+            responseCacheUsedBytes: 0,
+            hedgingEnabled: false,
+            hedgeDelayMs: 0,
 
             userBalance: 0.0,
             availableModels: [] as string[],
@@ -45,8 +50,8 @@ const aiSettings = defineComponent({
         try {
             AI.initialize();
             this.loadSettings();
-            this.refreshBalance();
-            this.refreshModels();
+            this.refreshBalance(false);
+            this.refreshModels(false);
         } catch (e) {
             showError(e as string || 'AI 初始化失败');
         }
@@ -62,33 +67,39 @@ const aiSettings = defineComponent({
                 this.temperature = settings.temperature;
                 this.topP = settings.topP;
                 this.maxTokens = settings.maxTokens;
+                this.contextTokens = settings.contextTokens;
                 this.systemPrompt = settings.systemPrompt;
+                const cacheInfo = AI.getResponseCacheInfo();
+                this.responseCacheEnabled = cacheInfo.enabled;
+                this.responseCacheUsedBytes = cacheInfo.usedBytes;
+                const hedging = AI.getHedging();
+                this.hedgingEnabled = hedging.enabled;
+                this.hedgeDelayMs = hedging.delayMs;
             } catch (e) {
                 showError(e as string || '加载设置失败');
             }
         },
 
-        refreshBalance() {
-            this.userBalance = 0.0;
-            showLoading();
-            AI.getUserBalance().then((balance) => {
+        // Opening the page shows the cached values; the buttons ask the server
+        refreshBalance(refresh: boolean) {
+            if (refresh) { showLoading(); }
+            AI.getUserBalance(refresh).then((balance) => {
                 this.userBalance = balance;
             }).catch((e) => {
                 showError(`获取余额失败: ${e}`);
             }).finally(() => {
-                hideLoading();
+                if (refresh) { hideLoading(); }
             });
         },
 
-        refreshModels() {
-            this.availableModels = [];
-            showLoading();
-            AI.getModels().then((models) => {
+        refreshModels(refresh: boolean) {
+            if (refresh) { showLoading(); }
+            AI.getModels(refresh).then((models) => {
                 this.availableModels = models;
             }).catch((e) => {
                 showError(`获取模型列表失败: ${e}`);
             }).finally(() => {
-                hideLoading();
+                if (refresh) { hideLoading(); }
             });
         },
 
@@ -101,8 +112,14 @@ const aiSettings = defineComponent({
             try {
                 AI.setSettings(this.apiKey, this.baseUrl,
                     this.modelName, this.maxTokens,
-                    this.temperature, this.topP, this.systemPrompt,);
+                    this.temperature, this.topP, this.systemPrompt,
+                    this.contextTokens);
+                AI.setResponseCache(this.responseCacheEnabled);
+                AI.setHedging(this.hedgingEnabled);
                 showSuccess('设置已保存');
+                // A new key or base URL empties the cache, so these fetch afresh
+                this.refreshBalance(false);
+                this.refreshModels(false);
             } catch (e) {
                 showError(e as string || '保存设置失败');
             }
@@ -140,6 +157,18 @@ const aiSettings = defineComponent({
             );
         },
 
+        editContextTokens() {
+            openSoftKeyboard(
+                () => this.contextTokens.toString(),
+                (value) => { this.contextTokens = parseInt(value); this.$forceUpdate(); },
+                (value) => {
+                    const parsed = parseInt(value);
+                    if (isNaN(parsed)) { return '请输入有效的数字'; }
+                    if (parsed <= this.maxTokens) { return '上下文长度必须大于最大长度'; }
+                }
+            );
+        },
+
         editTemperature() {
             openSoftKeyboard(
                 () => this.temperature.toFixed(1),
@@ -169,6 +198,26 @@ const aiSettings = defineComponent({
                 () => this.systemPrompt,
                 (value) => { this.systemPrompt = value; this.$forceUpdate(); }
             );
+        },
+
+        toggleResponseCache() {
+            this.responseCacheEnabled = !this.responseCacheEnabled;
+            this.$forceUpdate();
+        },
+
+        toggleHedging() {
+            this.hedgingEnabled = !this.hedgingEnabled;
+            this.$forceUpdate();
+        },
+
+        clearResponseCache() {
+            try {
+                AI.clearResponseCache();
+                this.responseCacheUsedBytes = 0;
+                showSuccess('缓存已清空');
+            } catch (e) {
+                showError(e as string || '清空缓存失败');
+            }
         }
     }
 });